@@ -0,0 +1,28 @@
+#include <stdexcept>
+
+#include "bsp.hpp"
+#include "fuzz.hpp"
+#include "game_lump.hpp"
+#include "lumps.hpp"
+#include "titanfall.hpp"
+
+
+// header & lump table parsing, as convert does before creating the output
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if (size == 0) { return 0; }  // can't mmap an empty file
+    std::string path = fuzz::write_input("input.bsp", data, size);
+    try {
+        Bsp bsp(path.c_str());
+        if (!bsp.is_valid()) { return 0; }
+        lumps::validate(bsp);
+        std::vector<titanfall::TricollHeader> headers;
+        bsp.load_lump(titanfall::TRICOLL_HEADER, headers);
+        for (int i = 0; i < 128; i++) {
+            auto lump = bsp.get_lump<const char>(i);
+            volatile char sink = lump.empty() ? 0 : lump.back();
+            (void)sink;
+        }
+        GameLumpView<titanfall::StaticProp> game_lump(bsp);
+    } catch (std::runtime_error &) {}
+    return 0;
+}
@@ -0,0 +1,22 @@
+#include <stdexcept>
+
+#include "convert.hpp"
+#include "fuzz.hpp"
+
+
+// a whole conversion, in-process, w/ the synthetic models
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if (size == 0) { return 0; }
+    std::string in = fuzz::write_input("input.bsp", data, size);
+    std::string out = (fuzz::work_dir() / "output.bsp").string();
+    std::string models = fuzz::model_dir();
+    ConvertOptions options;
+    options.print_report = false;
+    options.verify = true;
+    options.write_hashes = false;
+    options.model_dir = models.c_str();
+    try {
+        convert(in.c_str(), out.c_str(), options);
+    } catch (std::runtime_error &) {}
+    return 0;
+}
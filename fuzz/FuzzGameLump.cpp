@@ -0,0 +1,30 @@
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "bsp.hpp"
+#include "fuzz.hpp"
+#include "game_lump.hpp"
+#include "lumps.hpp"
+#include "titanfall.hpp"
+#include "titanfall2.hpp"
+
+
+// input is the GAME_LUMP of an otherwise empty map, so every mutation hits the sprp parser
+// -- sub-lump offsets are from the start of the file, so the lump is always at the same offset
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    std::vector<uint8_t> bsp(sizeof(BspHeader) + size);
+    BspHeader header = {.magic = MAGIC_rBSP, .version = titanfall::VERSION, .revision = 0, ._127 = 127, .lumps = {}};
+    header.lumps[titanfall::GAME_LUMP] = {sizeof(BspHeader), static_cast<uint32_t>(size), 0, 0};
+    memcpy(bsp.data(), &header, sizeof(header));
+    if (size > 0) { memcpy(&bsp[sizeof(header)], data, size); }
+    std::string path = fuzz::write_input("game_lump.bsp", bsp.data(), bsp.size());
+    try {
+        Bsp r1bsp(path.c_str());
+        GameLumpView<titanfall::StaticProp> r1(r1bsp);
+        std::vector<char> out(lumps::game_lump_length(r1));
+        lumps::write_game_lump(r1, out.data(), sizeof(BspHeader));
+        GameLumpView<titanfall2::StaticProp> r2(r1bsp);  // v13 parsing, when the version matches
+    } catch (std::runtime_error &) {}
+    return 0;
+}
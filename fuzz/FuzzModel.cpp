@@ -0,0 +1,18 @@
+#include <stdexcept>
+
+#include "fuzz.hpp"
+#include "models.hpp"
+
+
+// studiohdr_t -> studiohdr2_t -> per-tri AABB header & node tree
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if (size == 0) { return 0; }
+    std::string path = fuzz::write_input("input.mdl", data, size);
+    try {
+        Model model {path.c_str()};
+        model.getContents();
+        model.getFootprint(3);
+        model.getFootprint(16);
+    } catch (std::runtime_error &) {}
+    return 0;
+}
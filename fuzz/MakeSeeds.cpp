@@ -0,0 +1,43 @@
+// writes seed corpora for each fuzz target from the synthetic generator
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "bsp.hpp"
+#include "synthetic.hpp"
+#include "titanfall.hpp"
+
+namespace fs = std::filesystem;
+
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printf("USAGE: %s corpus_dir/\n", argv[0]);
+        return 0;
+    }
+    fs::path corpus = argv[1];
+    const uint64_t seeds[] = {1, 2, 3};
+    const uint32_t num_props[] = {0, 4, 32};
+    for (int i = 0; i < 3; i++) {
+        std::vector<char> map = synthetic::make_map(seeds[i], num_props[i]);
+        std::string name = "synthetic_" + std::to_string(seeds[i]);
+        synthetic::write_file(corpus / "bsp" / (name + ".bsp"), map);
+        synthetic::write_file(corpus / "convert" / (name + ".bsp"), map);
+        // GAME_LUMP alone, moved to where FuzzGameLump puts it
+        BspHeader header;
+        memcpy(&header, map.data(), sizeof(header));
+        LumpHeader &lump = header.lumps[titanfall::GAME_LUMP];
+        std::vector<char> game_lump(&map[lump.offset], &map[lump.offset] + lump.length);
+        for (uint32_t j = 0; j < *reinterpret_cast<uint32_t*>(game_lump.data()); j++) {
+            auto *sub_lump = reinterpret_cast<source::GameLumpHeader*>(&game_lump[4 + j * sizeof(source::GameLumpHeader)]);
+            sub_lump->offset = sub_lump->offset - lump.offset + sizeof(BspHeader);
+        }
+        synthetic::write_file(corpus / "game_lump" / name, game_lump);
+    }
+    for (auto &model : synthetic::models()) {
+        synthetic::write_file(corpus / "model" / fs::path(model.name).filename(), model.data);
+    }
+    printf("wrote seeds to %s\n", corpus.string().c_str());
+    return 0;
+}
@@ -0,0 +1,44 @@
+// shared by the fuzz targets; each target defines LLVMFuzzerTestOneInput
+// NOTE: the parsers read files, so each input is written to a per-process temp file first
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <unistd.h>
+
+#include "synthetic.hpp"
+
+
+namespace fuzz {
+    std::filesystem::path work_dir() {
+        static std::filesystem::path dir = [] {
+            auto path = std::filesystem::temp_directory_path() / ("bsp_regen_fuzz_" + std::to_string(getpid()));
+            std::filesystem::create_directories(path);
+            return path;
+        }();
+        return dir;
+    }
+
+    // the synthetic models, for targets which load a map's models
+    std::string model_dir() {
+        static std::string dir = [] {
+            for (auto &model : synthetic::models()) {
+                synthetic::write_file(work_dir() / "r1" / model.name, model.data);
+            }
+            return (work_dir() / "r1").string();
+        }();
+        return dir;
+    }
+
+    std::string write_input(const char *name, const uint8_t *data, size_t size) {
+        std::filesystem::path path = work_dir() / name;
+        FILE *file = fopen(path.string().c_str(), "wb");
+        if (file == nullptr) { abort(); }
+        fwrite(data, 1, size, file);
+        fclose(file);
+        return path.string();
+    }
+};
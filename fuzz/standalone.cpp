@@ -0,0 +1,61 @@
+// replays inputs through LLVMFuzzerTestOneInput, for compilers w/o libFuzzer (e.g. gcc)
+// -- pair w/ the sanitizers to catch what each input triggers
+// -- -mutate=N also runs N random byte-level mutations of each input; not coverage guided
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+
+int main(int argc, char* argv[]) {
+    unsigned long mutations = 0;
+    std::vector<std::filesystem::path> inputs;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "-mutate=", 8) == 0) {
+            mutations = strtoul(&argv[i][8], nullptr, 10);
+        } else if (std::filesystem::is_directory(argv[i])) {
+            for (auto &entry : std::filesystem::directory_iterator(argv[i])) {
+                if (entry.is_regular_file()) { inputs.push_back(entry.path()); }
+            }
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+    if (inputs.empty()) {
+        printf("USAGE: %s [-mutate=N] input_or_corpus_dir...\n", argv[0]);
+        return 0;
+    }
+
+    std::mt19937 rng(0);
+    for (auto &path : inputs) {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<uint8_t> input((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+        if (input.empty()) { continue; }
+        // flip bytes & plant boundary values, a few at a time
+        const uint32_t interesting[] = {0, 1, 0x7F, 0x80, 0xFF, 0x7FFF, 0xFFFF, 0x7FFFFFFF, 0xFFFFFFFF};
+        for (unsigned long m = 0; m < mutations; m++) {
+            std::vector<uint8_t> mutant = input;
+            for (int edits = 1 + rng() % 4; edits > 0; edits--) {
+                size_t offset = rng() % mutant.size();
+                if (rng() % 2 || mutant.size() - offset < 4) {
+                    mutant[offset] ^= static_cast<uint8_t>(1 + rng() % 255);
+                } else {
+                    uint32_t value = interesting[rng() % std::size(interesting)];
+                    memcpy(&mutant[offset & ~3ull], &value, std::min<size_t>(4, mutant.size() - (offset & ~3ull)));
+                }
+            }
+            if (rng() % 8 == 0) { mutant.resize(rng() % mutant.size()); }  // truncated
+            LLVMFuzzerTestOneInput(mutant.data(), mutant.size());
+        }
+    }
+    printf("%zu inputs, %lu mutations each\n", inputs.size(), mutations);
+    return 0;
+}
@@ -0,0 +1,429 @@
+// CPython extension module: zero-copy lump views & in process conversion
+// -- built w/ cmake -DBSP_REGEN_PYTHON=ON, then `import bsp_regen`
+// -- bsp_regen.Bsp(path_or_bytes).lump(index) is a read only memoryview straight into the .bsp
+//    struct lumps export a PEP 3118 format, so numpy.asarray(view) gives a structured array w/o copying
+// -- bsp_regen.convert(path_or_bytes, model_resolver) runs w/o the GIL, so Python threads can batch conversions
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bsp.hpp"
+#include "convert.hpp"
+#include "lumps.hpp"
+#include "titanfall.hpp"
+#include "titanfall2.hpp"
+
+
+// PEP 3118 formats of the lumps we have structs for; anything else is exported as bytes
+struct LumpFormat {
+    int          index;
+    Py_ssize_t   itemsize;
+    const char  *format;
+};
+
+const LumpFormat FORMATS[] = {
+    {titanfall::MODELS,                sizeof(titanfall::Model),         "T{(3)f:mins:(3)f:maxs:I:first_mesh:I:num_meshes:}"},
+    {titanfall::TRICOLL_TRIS,          sizeof(uint32_t),                 "I"},
+    {titanfall::TRICOLL_HEADER,        sizeof(titanfall::TricollHeader), "T{h:flags:h:texture_flags:h:texture_data:h:num_vertices:"
+        "H:num_triangles:H:num_bevel_indices:i:first_vertex:I:first_triangle:I:first_node:I:first_bevel_index:(3)f:origin:f:scale:}"},
+    {titanfall::CM_GRID,               sizeof(titanfall::Grid),          "T{f:scale:(2)i:cell_offset:(2)i:num_cells:i:num_straddle_groups:i:first_brush_plane:}"},
+    {titanfall::CM_GRID_CELLS,         sizeof(titanfall::GridCell),      "T{H:first_geo_set:H:num_geo_sets:}"},
+    {titanfall::CM_GEO_SETS,           sizeof(titanfall::GeoSet),        "T{H:straddle_group:H:num_primitives:I:primitive:}"},
+    {titanfall::CM_GEO_SET_BOUNDS,     sizeof(titanfall::Bounds),        "T{(3)h:origin:h:sin:(3)h:extents:h:cos:}"},
+    {titanfall::CM_PRIMITIVES,         sizeof(uint32_t),                 "I"},
+    {titanfall::CM_PRIMITIVE_BOUNDS,   sizeof(titanfall::Bounds),        "T{(3)h:origin:h:sin:(3)h:extents:h:cos:}"},
+    {titanfall::CM_UNIQUE_CONTENTS,    sizeof(uint32_t),                 "I"},
+    {titanfall::TRICOLL_BEVEL_STARTS,  sizeof(uint16_t),                 "H"},
+    {titanfall::TRICOLL_BEVEL_INDICES, sizeof(uint32_t),                 "I"},
+};
+
+// LIGHTPROBE_REFS grew a member in r2
+const LumpFormat R1_LIGHTPROBE_REFS = {titanfall::LIGHTPROBE_REFS, sizeof(titanfall::LightProbeRef), "T{(3)f:origin:I:probe:}"};
+const LumpFormat R2_LIGHTPROBE_REFS = {titanfall2::LIGHTPROBE_REFS, sizeof(titanfall2::LightProbeRef), "T{(3)f:origin:I:probe:i:unknown:}"};
+const LumpFormat BYTES = {0, 1, "B"};
+
+
+const LumpFormat &lump_format(int version, int index) {
+    if (index == titanfall::LIGHTPROBE_REFS) {
+        return version == titanfall::VERSION ? R1_LIGHTPROBE_REFS : R2_LIGHTPROBE_REFS;
+    }
+    for (const LumpFormat &format : FORMATS) {
+        if (format.index == index) { return format; }
+    }
+    return BYTES;
+}
+
+
+// turns the C++ exception currently being handled into a Python exception
+PyObject *raise_current_exception() {
+    try {
+        throw;
+    } catch (std::invalid_argument &e) {
+        PyErr_SetString(PyExc_ValueError, e.what());
+    } catch (std::exception &e) {
+        PyErr_SetString(PyExc_RuntimeError, e.what());
+    }
+    return nullptr;
+}
+
+
+// a path (str or os.PathLike) as a std::string; false w/ a Python exception set otherwise
+bool fs_path(PyObject *object, std::string &path) {
+    PyObject *encoded = nullptr;
+    if (!PyUnicode_FSConverter(object, &encoded)) { return false; }
+    path = PyBytes_AS_STRING(encoded);
+    Py_DECREF(encoded);
+    return true;
+}
+
+
+// Bsp
+// -- a .bsp file (mapped) or a bytes-like object (borrowed, & kept alive until the Bsp is freed)
+struct PyBsp {
+    PyObject_HEAD
+    Bsp        *bsp;  // null until __init__ succeeds
+    Py_buffer   source;  // only if made from a bytes-like object
+    bool        has_source;
+    Py_ssize_t  exports;  // live LumpViews, which point into bsp
+};
+
+
+// frees what a previous __init__ loaded
+void PyBsp_release(PyBsp *self) {
+    delete self->bsp;
+    self->bsp = nullptr;
+    if (self->has_source) { PyBuffer_Release(&self->source); }
+    self->has_source = false;
+}
+
+
+// false w/ a Python exception set if __init__ never succeeded (e.g. Bsp.__new__(Bsp))
+bool PyBsp_loaded(PyBsp *self) {
+    if (self->bsp == nullptr) {
+        PyErr_SetString(PyExc_ValueError, "Bsp is not initialised");
+        return false;
+    }
+    return true;
+}
+
+
+int PyBsp_init(PyBsp *self, PyObject *args, PyObject *kwargs) {
+    const char *keywords[] = {"source", nullptr};
+    PyObject *source;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O:Bsp", const_cast<char**>(keywords), &source)) { return -1; }
+    if (self->exports > 0) {
+        PyErr_SetString(PyExc_BufferError, "Can't re-initialise a Bsp while views of its lumps exist");
+        return -1;
+    }
+    PyBsp_release(self);
+    try {
+        if (PyObject_CheckBuffer(source)) {  // bytes-like is the .bsp itself, str & os.PathLike are paths
+            if (PyObject_GetBuffer(source, &self->source, PyBUF_SIMPLE) != 0) { return -1; }
+            self->has_source = true;
+            self->bsp = new Bsp(static_cast<const char*>(self->source.buf), static_cast<size_t>(self->source.len));
+        } else {
+            std::string path;
+            if (!fs_path(source, path)) { return -1; }
+            self->bsp = new Bsp(path.c_str());
+        }
+    } catch (...) {
+        raise_current_exception();
+        return -1;
+    }
+    return 0;
+}
+
+
+void PyBsp_dealloc(PyBsp *self) {
+    PyBsp_release(self);
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+
+// LumpView
+// -- exports 1 lump of a Bsp through the buffer protocol; memoryview(LumpView) is what Bsp.lump returns
+struct PyLumpView {
+    PyObject_HEAD
+    PyBsp        *owner;  // strong reference, so the mapping outlives every view of it
+    char         *data;
+    Py_ssize_t    shape[1];
+    Py_ssize_t    strides[1];
+    Py_ssize_t    itemsize;
+    const char   *format;
+};
+
+
+int PyLumpView_getbuffer(PyLumpView *self, Py_buffer *view, int flags) {
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "Bsp lumps are read only");
+        return -1;
+    }
+    view->obj        = Py_NewRef(reinterpret_cast<PyObject*>(self));
+    view->buf        = self->data;
+    view->len        = self->shape[0] * self->itemsize;
+    view->readonly   = 1;
+    view->itemsize   = self->itemsize;
+    view->format     = (flags & PyBUF_FORMAT) ? const_cast<char*>(self->format) : nullptr;
+    view->ndim       = 1;
+    view->shape      = (flags & PyBUF_ND) ? self->shape : nullptr;
+    view->strides    = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : nullptr;
+    view->suboffsets = nullptr;
+    view->internal   = nullptr;
+    return 0;
+}
+
+
+void PyLumpView_dealloc(PyLumpView *self) {
+    if (self->owner != nullptr) { self->owner->exports--; }
+    Py_XDECREF(self->owner);
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+
+PyBufferProcs PyLumpView_buffer = {
+    reinterpret_cast<getbufferproc>(PyLumpView_getbuffer),
+    nullptr
+};
+
+
+PyTypeObject PyLumpViewType = [] {
+    PyTypeObject type = {PyVarObject_HEAD_INIT(nullptr, 0)};
+    type.tp_name      = "bsp_regen.LumpView";
+    type.tp_basicsize = sizeof(PyLumpView);
+    type.tp_dealloc   = reinterpret_cast<destructor>(PyLumpView_dealloc);
+    type.tp_as_buffer = &PyLumpView_buffer;
+    type.tp_flags     = Py_TPFLAGS_DEFAULT;
+    type.tp_doc       = "1 lump of a Bsp, exported through the buffer protocol";
+    return type;
+}();
+
+
+bool lump_index(PyObject *arg, int &index) {
+    long value = PyLong_AsLong(arg);
+    if (value == -1 && PyErr_Occurred()) { return false; }
+    if (value < 0 || value >= 128) {
+        PyErr_SetString(PyExc_IndexError, "lump index must be in [0, 128)");
+        return false;
+    }
+    index = static_cast<int>(value);
+    return true;
+}
+
+
+PyObject *PyBsp_lump(PyBsp *self, PyObject *arg) {
+    int index;
+    if (!PyBsp_loaded(self) || !lump_index(arg, index)) { return nullptr; }
+    try {
+        self->bsp->check_lump(index);
+    } catch (...) {
+        return raise_current_exception();
+    }
+    LumpHeader &header = self->bsp->header_->lumps[index];
+    const LumpFormat *format = &lump_format(static_cast<int>(self->bsp->header_->version), index);
+    if (header.length % format->itemsize != 0) { format = &BYTES; }  // truncated, don't pretend it's whole structs
+
+    PyLumpView *view = PyObject_New(PyLumpView, &PyLumpViewType);
+    if (view == nullptr) { return nullptr; }
+    view->owner      = reinterpret_cast<PyBsp*>(Py_NewRef(reinterpret_cast<PyObject*>(self)));
+    self->exports++;
+    view->data       = self->bsp->file_.rawdata(header.offset);
+    view->itemsize   = format->itemsize;
+    view->shape[0]   = header.length / format->itemsize;
+    view->strides[0] = format->itemsize;
+    view->format     = format->format;
+    PyObject *memoryview = PyMemoryView_FromObject(reinterpret_cast<PyObject*>(view));
+    Py_DECREF(view);
+    return memoryview;
+}
+
+
+PyObject *PyBsp_lump_header(PyBsp *self, PyObject *arg) {
+    int index;
+    if (!PyBsp_loaded(self) || !lump_index(arg, index)) { return nullptr; }
+    LumpHeader &header = self->bsp->header_->lumps[index];
+    return Py_BuildValue("(IIII)", header.offset, header.length, header.version, header.fourCC);
+}
+
+
+PyObject *PyBsp_get_version(PyBsp *self, void*) {
+    return PyBsp_loaded(self) ? PyLong_FromUnsignedLong(self->bsp->header_->version) : nullptr;
+}
+
+PyObject *PyBsp_get_revision(PyBsp *self, void*) {
+    return PyBsp_loaded(self) ? PyLong_FromUnsignedLong(self->bsp->header_->revision) : nullptr;
+}
+
+
+PyMethodDef PyBsp_methods[] = {
+    {"lump", reinterpret_cast<PyCFunction>(PyBsp_lump), METH_O,
+        "lump(index) -> read only memoryview of the lump, typed where bsp_regen knows the struct"},
+    {"lump_header", reinterpret_cast<PyCFunction>(PyBsp_lump_header), METH_O,
+        "lump_header(index) -> (offset, length, version, fourCC)"},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+
+PyGetSetDef PyBsp_getset[] = {
+    {"version",  reinterpret_cast<getter>(PyBsp_get_version),  nullptr, "BspHeader.version", nullptr},
+    {"revision", reinterpret_cast<getter>(PyBsp_get_revision), nullptr, "BspHeader.revision", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+
+PyTypeObject PyBspType = [] {
+    PyTypeObject type = {PyVarObject_HEAD_INIT(nullptr, 0)};
+    type.tp_name      = "bsp_regen.Bsp";
+    type.tp_basicsize = sizeof(PyBsp);
+    type.tp_dealloc   = reinterpret_cast<destructor>(PyBsp_dealloc);
+    type.tp_flags     = Py_TPFLAGS_DEFAULT;
+    type.tp_doc       = "Bsp(path_or_buffer): a .bsp file, or a .bsp already in memory";
+    type.tp_methods   = PyBsp_methods;
+    type.tp_getset    = PyBsp_getset;
+    type.tp_init      = reinterpret_cast<initproc>(PyBsp_init);
+    type.tp_new       = PyType_GenericNew;
+    return type;
+}();
+
+
+// model_resolver(name) -> path, called from conversion threads
+// -- takes the GIL for each call; a Python exception becomes a C++ one, which fails the conversion
+std::function<std::string(const std::string&)> python_resolver(PyObject *resolver) {
+    return [resolver](const std::string &name) -> std::string {
+        PyGILState_STATE gil = PyGILState_Ensure();
+        std::string path, error;
+        PyObject *result = PyObject_CallFunction(resolver, "s#", name.data(), static_cast<Py_ssize_t>(name.size()));
+        if (result == nullptr || !fs_path(result, path)) {
+            PyObject *type, *value, *traceback;
+            PyErr_Fetch(&type, &value, &traceback);
+            PyObject *message = value ? PyObject_Str(value) : nullptr;
+            error = "model_resolver failed for " + name + ": " + (message ? PyUnicode_AsUTF8(message) : "unknown error");
+            Py_XDECREF(message);
+            Py_XDECREF(type);
+            Py_XDECREF(value);
+            Py_XDECREF(traceback);
+        }
+        Py_XDECREF(result);
+        PyGILState_Release(gil);
+        if (!error.empty()) { throw std::runtime_error(error); }
+        return path;
+    };
+}
+
+
+PyObject *py_convert(PyObject*, PyObject *args, PyObject *kwargs) {
+    const char *keywords[] = {"source", "model_resolver", "output", "threads", "verify", "io", nullptr};
+    PyObject *source, *resolver = Py_None, *output = Py_None;
+    unsigned threads = 1;
+    int verify = 0;
+    const char *io = "mmap";
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|OO$Ips:convert", const_cast<char**>(keywords),
+            &source, &resolver, &output, &threads, &verify, &io)) {
+        return nullptr;
+    }
+
+    ConvertOptions options;
+    options.num_threads  = std::max(1u, threads);
+    options.print_report = false;
+    options.verify       = verify != 0;
+    options.write_hashes = false;
+    if (!parse_io_backend(io, options.io)) {
+        PyErr_Format(PyExc_ValueError, "Unknown I/O backend: '%s'", io);
+        return nullptr;
+    }
+    std::string model_dir;
+    if (PyCallable_Check(resolver)) {
+        options.model_resolver = python_resolver(resolver);
+    } else if (resolver != Py_None) {  // a directory, like --model-dir
+        if (!fs_path(resolver, model_dir)) { return nullptr; }
+        options.model_dir = model_dir.c_str();
+    }
+    std::string out_filename = "<memory>";
+    std::vector<char> memory;
+    if (output == Py_None) {
+        options.output_memory = &memory;
+    } else if (!fs_path(output, out_filename)) {
+        return nullptr;
+    }
+
+    // the input stays borrowed (& pinned) while the GIL is released
+    Py_buffer buffer;
+    bool from_buffer = PyObject_CheckBuffer(source);
+    std::string in_filename = "<memory>";
+    if (from_buffer) {
+        if (PyObject_GetBuffer(source, &buffer, PyBUF_SIMPLE) != 0) { return nullptr; }
+    } else if (!fs_path(source, in_filename)) {
+        return nullptr;
+    }
+
+    int result = 0;
+    std::string error;
+    bool invalid_argument = false;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        std::unique_ptr<Bsp> r1bsp = from_buffer
+            ? std::make_unique<Bsp>(static_cast<const char*>(buffer.buf), static_cast<size_t>(buffer.len))
+            : std::make_unique<Bsp>(in_filename.c_str());
+        result = convert(*r1bsp, in_filename.c_str(), out_filename.c_str(), options);
+    } catch (std::invalid_argument &e) {
+        error = e.what();
+        invalid_argument = true;
+    } catch (std::exception &e) {
+        error = e.what();
+    }
+    Py_END_ALLOW_THREADS
+    if (from_buffer) { PyBuffer_Release(&buffer); }
+
+    if (!error.empty()) {
+        PyErr_SetString(invalid_argument ? PyExc_ValueError : PyExc_RuntimeError, error.c_str());
+        return nullptr;
+    }
+    if (result != 0) {
+        PyErr_SetString(PyExc_RuntimeError, "Conversion failed (not a Titanfall map, or --verify found errors)");
+        return nullptr;
+    }
+    if (output == Py_None) {
+        return PyBytes_FromStringAndSize(memory.data(), static_cast<Py_ssize_t>(memory.size()));
+    }
+    Py_RETURN_NONE;
+}
+
+
+PyObject *py_lump_name(PyObject*, PyObject *arg) {
+    int index;
+    if (!lump_index(arg, index)) { return nullptr; }
+    return PyUnicode_FromString(lumps::DESCRIPTORS[index].name);
+}
+
+
+PyMethodDef module_methods[] = {
+    {"convert", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(py_convert)), METH_VARARGS | METH_KEYWORDS,
+        "convert(source, model_resolver=None, output=None, *, threads=1, verify=False, io='mmap')\n"
+        "source is a Titanfall .bsp path or bytes-like object\n"
+        "model_resolver is a directory of models (default 'r1'), or a callable mapping each model name to a path\n"
+        "returns the Titanfall 2 .bsp as bytes, or writes it to output & returns None"},
+    {"lump_name", reinterpret_cast<PyCFunction>(py_lump_name), METH_O, "lump_name(index) -> str"},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+
+PyModuleDef module_def = {
+    PyModuleDef_HEAD_INIT, "bsp_regen", "Titanfall -> Titanfall 2 .bsp conversion", -1, module_methods,
+    nullptr, nullptr, nullptr, nullptr
+};
+
+
+PyMODINIT_FUNC PyInit_bsp_regen() {
+    if (PyType_Ready(&PyBspType) < 0 || PyType_Ready(&PyLumpViewType) < 0) { return nullptr; }
+    PyObject *module = PyModule_Create(&module_def);
+    if (module == nullptr) { return nullptr; }
+    if (PyModule_AddObjectRef(module, "Bsp", reinterpret_cast<PyObject*>(&PyBspType)) < 0) {
+        Py_DECREF(module);
+        return nullptr;
+    }
+    return module;
+}
@@ -0,0 +1,94 @@
+# smoke test for the bsp_regen module
+# -- usage: PYTHONPATH=build/python python3 python/test_bindings.py titanfall_map.bsp [model_dir]
+import os
+import sys
+import threading
+
+import bsp_regen
+
+MODELS, TRICOLL_HEADER, CM_GRID = 0x0E, 0x45, 0x55
+
+
+def main(path, model_dir="r1"):
+    with open(path, "rb") as f:
+        raw = f.read()
+    failures = 0
+
+    def check(ok, message):
+        nonlocal failures
+        if not ok:
+            print(f"FAILED: {message}")
+            failures += 1
+
+    for source in (path, raw):
+        bsp = bsp_regen.Bsp(source)
+        check(bsp.version == 29, "version")
+        for index in range(128):
+            offset, length, _, _ = bsp.lump_header(index)
+            view = bsp.lump(index)
+            check(view.readonly, f"lump {index:#04x} is read only")
+            check(view.nbytes == length and view.cast("B") == raw[offset:offset + length], f"lump {index:#04x} bytes")
+        check(bsp.lump(MODELS).itemsize == 32 and bsp.lump(MODELS).format.startswith("T{"), "MODELS is typed")
+        check(bsp.lump(TRICOLL_HEADER).itemsize == 0x2C, "TRICOLL_HEADER is typed")
+        check(bsp.lump(CM_GRID).nbytes in (0, 28), "CM_GRID is 1 Grid")
+    check(bsp_regen.lump_name(MODELS) == "MODELS", "lump_name")
+
+    # a view keeps its Bsp alive
+    offset, length, _, _ = bsp_regen.Bsp(path).lump_header(MODELS)
+    view = bsp_regen.Bsp(path).lump(MODELS)
+    check(view.cast("B") == raw[offset:offset + length], "view outlives its Bsp")
+
+    # uninitialised & re-initialised Bsps
+    empty = bsp_regen.Bsp.__new__(bsp_regen.Bsp)
+    for use in (lambda: empty.version, lambda: empty.revision, lambda: empty.lump(MODELS), lambda: empty.lump_header(MODELS)):
+        try:
+            use()
+            check(False, "an uninitialised Bsp raises")
+        except ValueError:
+            pass
+    bsp = bsp_regen.Bsp(raw)
+    bsp.__init__(path)
+    check(bsp.lump_header(MODELS) == (offset, length) + bsp.lump_header(MODELS)[2:], "re-initialised Bsp")
+    view = bsp.lump(MODELS)
+    try:
+        bsp.__init__(raw)
+        check(False, "re-initialising a Bsp w/ views of it raises")
+    except BufferError:
+        pass
+    check(view.cast("B") == raw[offset:offset + length], "views survive a refused re-initialisation")
+    del view
+    bsp.__init__(raw)
+    check(bsp.version == 29, "re-initialised once its views are gone")
+
+    expected = bsp_regen.convert(path, model_dir)
+    check(expected[:4] == b"rBSP", "converted to memory")
+    check(bsp_regen.convert(raw, model_dir, threads=4) == expected, "bytes input matches path input")
+    resolved = []
+    def resolver(name):
+        resolved.append(name)
+        return os.path.join(model_dir, name)
+    check(bsp_regen.convert(raw, resolver, threads=4) == expected, "callable model_resolver")
+    if resolved:  # the map has props
+        try:
+            bsp_regen.convert(raw, lambda name: 1 / 0)
+            check(False, "model_resolver errors fail the conversion")
+        except RuntimeError:
+            pass
+
+    # conversions run w/o the GIL
+    results = [None] * 4
+    def worker(i):
+        results[i] = bsp_regen.convert(raw, model_dir)
+    threads = [threading.Thread(target=worker, args=(i,)) for i in range(4)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    check(all(result == expected for result in results), "concurrent conversions")
+
+    print(f"{failures} failures")
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(*sys.argv[1:]))
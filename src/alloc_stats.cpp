@@ -0,0 +1,40 @@
+// replaces the global operator new & delete, counting into alloc_stats::counters while alloc_stats::enabled
+// NOTE: only linked into the bsp_regen executable, see alloc_stats.hpp
+#include <cstdlib>
+#include <new>
+
+#include "alloc_stats.hpp"
+
+
+void *operator new(size_t size) {
+    if (size == 0) { size = 1; }
+    void *ptr;
+    if (alloc_stats::enabled.load(std::memory_order_relaxed)) {
+        uint64_t start = alloc_stats::now();
+        ptr = malloc(size);
+        alloc_stats::counters.nanoseconds += alloc_stats::now() - start;
+        alloc_stats::counters.allocations++;
+        alloc_stats::counters.bytes += size;
+    } else {
+        ptr = malloc(size);
+    }
+    if (ptr == nullptr) { throw std::bad_alloc(); }
+    return ptr;
+}
+
+
+void operator delete(void *ptr) noexcept {
+    if (ptr != nullptr && alloc_stats::enabled.load(std::memory_order_relaxed)) {
+        uint64_t start = alloc_stats::now();
+        free(ptr);
+        alloc_stats::counters.nanoseconds += alloc_stats::now() - start;
+        alloc_stats::counters.frees++;
+    } else {
+        free(ptr);
+    }
+}
+
+
+void operator delete(void *ptr, size_t) noexcept {
+    operator delete(ptr);
+}
@@ -0,0 +1,48 @@
+// heap allocation counters, for measuring allocator pressure per conversion stage
+// -- counted by the operator new & delete in alloc_stats.cpp, which only the bsp_regen executable links
+//    (a library, e.g. the Python module, mustn't replace its host's allocator); elsewhere every count stays 0
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+
+namespace alloc_stats {
+    inline std::atomic<bool> enabled = false;
+    inline FILE *out = stdout;  // stderr while the converted map itself goes to stdout
+
+    struct Counters {
+        uint64_t  allocations   = 0;
+        uint64_t  frees         = 0;
+        uint64_t  bytes         = 0;
+        uint64_t  nanoseconds   = 0;  // inside malloc & free
+    };
+
+    // per thread, so stages running in parallel don't count each other
+    inline thread_local Counters counters;
+
+    inline uint64_t now() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // prints the allocations made on this thread while in scope
+    struct Scope {
+        const char *name;
+        Counters    start;
+
+        Scope(const char *stage_name) : name(stage_name), start(counters) {}
+
+        ~Scope() {
+            if (!enabled) { return; }
+            fprintf(out, "%s: %llu allocations (%llu KiB), %llu frees, %.3f ms in allocator\n", name,
+                static_cast<unsigned long long>(counters.allocations - start.allocations),
+                static_cast<unsigned long long>((counters.bytes - start.bytes) / 1024),
+                static_cast<unsigned long long>(counters.frees - start.frees),
+                (counters.nanoseconds - start.nanoseconds) / 1e6);
+        }
+    };
+};
+
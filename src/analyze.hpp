@@ -0,0 +1,141 @@
+// --analyze: which maps will convert, & how close they come to the CM_GRID index limits
+// -- runs convertTricoll & addPropsToCmGrid only, to size every lump; no output file is created
+// -- maps are analysed in parallel (1 per thread), sharing warm model metadata
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include "bsp.hpp"
+#include "convert.hpp"
+#include "game_lump.hpp"
+#include "lumps.hpp"
+#include "models.hpp"
+#include "tasks.hpp"
+#include "titanfall.hpp"
+
+
+struct MapAnalysis {
+    std::string     filename;
+    std::string     error;  // why the map can't be converted, if it can't
+    uint64_t        r1_size = 0;
+    uint64_t        projected_size = 0;  // of the .bsp, w/ every lump internal
+    uint32_t        lump_lengths[128] = {};  // projected
+    CapacityReport  capacity;
+
+    // the tightest limit, as a fraction of it left unused; < 0 if any is exceeded
+    double headroom() const {
+        auto left = [](uint32_t value, uint32_t limit) { return 1.0 - static_cast<double>(value) / limit; };
+        return std::min({
+            left(capacity.unique_contents,     CapacityReport::MAX_UNIQUE_CONTENTS),
+            left(capacity.geo_sets,            CapacityReport::MAX_GEO_SETS),
+            left(capacity.straddle_groups,     CapacityReport::MAX_STRADDLE_GROUPS),
+            left(capacity.max_prop_index,      CapacityReport::MAX_INDEX),
+            left(capacity.max_first_primitive, CapacityReport::MAX_INDEX)});
+    }
+
+    // total projected length of the lumps generated by stage
+    uint64_t generated(lumps::Stage stage) const {
+        uint64_t total = 0;
+        for (int i = 0; i < 128; i++) {
+            if (lumps::DESCRIPTORS[i].stage == stage) { total += lump_lengths[i]; }
+        }
+        return total;
+    }
+};
+
+
+MapAnalysis analyzeMap(const std::string &filename, const ConvertOptions &options) {
+    MapAnalysis analysis;
+    analysis.filename = filename;
+    try {
+        Bsp r1bsp(filename.c_str());
+        if (!r1bsp.is_valid() || r1bsp.header_->version != titanfall::VERSION) {
+            analysis.error = "not a Titanfall map";
+            return analysis;
+        }
+        analysis.r1_size = r1bsp.file_.size();
+        lumps::validate(r1bsp);
+        GameLumpView<titanfall::StaticProp> gameLump(r1bsp);
+
+        lumps::GeneratedLumps generated;
+        ConversionReport report;
+        {
+            std::pmr::monotonic_buffer_resource arena;
+            convertTricoll(r1bsp, generated.tricoll_headers, generated.bevel_starts, generated.bevel_indices, &arena);
+        }
+        {
+            std::pmr::monotonic_buffer_resource arena;
+            addPropsToCmGrid(r1bsp, gameLump, generated.grid, generated.grid_cells, generated.geo_sets, generated.geo_set_bounds,
+                generated.primitives, generated.primitive_bounds, generated.unique_contents,
+                options, report, &arena, false);
+        }
+        analysis.capacity = report.capacity;
+        analysis.error = report.capacity.exceeded();
+
+        // laid out like convert does: r1 order, each lump 4 byte aligned
+        lumps::Sources sources = {r1bsp, gameLump, generated};
+        std::vector<SortKey> lumpOrder;
+        for (int i = 0; i < 128; i++) {
+            int offset = static_cast<int>(r1bsp.header_->lumps[i].offset);
+            if (offset != 0) { lumpOrder.push_back({offset, i}); }
+        }
+        std::sort(lumpOrder.begin(), lumpOrder.end(), [](auto a, auto b) { return a.offset < b.offset; });
+        analysis.projected_size = sizeof(BspHeader);
+        for (SortKey &lump : lumpOrder) {
+            analysis.lump_lengths[lump.index] = lumps::LENGTHS[lump.index](sources);
+            analysis.projected_size = ((analysis.projected_size + 3) & ~3ull) + analysis.lump_lengths[lump.index];
+        }
+    } catch (std::exception &e) {
+        analysis.error = e.what();
+    }
+    return analysis;
+}
+
+
+// in the order given
+std::vector<MapAnalysis> analyze(const std::vector<std::string> &filenames, ConvertOptions options) {
+    ModelCache models;
+    if (options.model_cache == nullptr) { options.model_cache = &models; }
+    std::vector<MapAnalysis> analyses(filenames.size());
+    TaskGraph graph;
+    for (size_t i = 0; i < filenames.size(); i++) {
+        graph.add("analyzeMap", [&, i]() { analyses[i] = analyzeMap(filenames[i], options); });
+    }
+    graph.run(options.num_threads);
+    return analyses;
+}
+
+
+void printAnalysis(const std::vector<MapAnalysis> &analyses) {
+    printf("%-32s %9s %9s %9s %9s %8s %9s %11s %9s %9s %8s  %s\n", "Map", "r1 KiB", "r2 KiB", "tricoll", "CM_GRID",
+        "Contents", "GeoSets", "Straddle", "Prop idx", "Prim idx", "Headroom", "Status");
+    printf("%-32s %9s %9s %9s %9s %8u %9u %11u %9u %9u\n", "(limit)", "", "", "KiB", "KiB",
+        CapacityReport::MAX_UNIQUE_CONTENTS, CapacityReport::MAX_GEO_SETS, CapacityReport::MAX_STRADDLE_GROUPS,
+        CapacityReport::MAX_INDEX, CapacityReport::MAX_INDEX);
+    uint32_t failures = 0;
+    for (const MapAnalysis &map : analyses) {
+        std::string name = std::filesystem::path(map.filename).filename().string();
+        if (map.projected_size == 0) {  // couldn't be analysed at all
+            printf("%-32s %9llu %9s %9s %9s %8s %9s %11s %9s %9s %8s  FAIL: %s\n", name.c_str(),
+                static_cast<unsigned long long>(map.r1_size >> 10), "-", "-", "-", "-", "-", "-", "-", "-", "-", map.error.c_str());
+            failures++;
+            continue;
+        }
+        const CapacityReport &capacity = map.capacity;
+        std::string straddle = std::to_string(capacity.r1_straddle_groups) + "->" + std::to_string(capacity.straddle_groups);
+        printf("%-32s %9llu %9llu %9llu %9llu %8u %9u %11s %9u %9u %7.1f%%  %s%s\n", name.c_str(),
+            static_cast<unsigned long long>(map.r1_size >> 10), static_cast<unsigned long long>(map.projected_size >> 10),
+            static_cast<unsigned long long>(map.generated(lumps::Stage::TRICOLL) >> 10),
+            static_cast<unsigned long long>(map.generated(lumps::Stage::CM_GRID) >> 10),
+            capacity.unique_contents, capacity.geo_sets, straddle.c_str(), capacity.max_prop_index, capacity.max_first_primitive,
+            100.0 * map.headroom(), map.error.empty() ? "ok" : "FAIL: ", map.error.c_str());
+        failures += !map.error.empty();
+    }
+    printf("%zu maps, %u will fail\n", analyses.size(), failures);
+}
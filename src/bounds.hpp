@@ -1,5 +1,9 @@
+#pragma once
+
+#include <algorithm>
 #include <cmath>
 #include <cstdint>
+#include <cstdio>
 #include <immintrin.h>
 #include <limits>
 
@@ -30,13 +34,18 @@ struct MinMax {
 // -- GCC-only:  __m128_var[0]
 // -- MSVC-only: __m128_var.m128_f32[0]
 // -- if you have a better cross-platform solution: implement it! please!
+// the x & y of a corner, as testCollision sees them
+// NOTE: _MM_SHUFFLE(1, 1, 2, 3) moves lane 3 (not y) into lane 0; outputs depend on this, so it's kept as is
+void collision_xy(__m128 corner, float &x, float &y) {
+    x = _mm_cvtss_f32(corner);
+    y = _mm_cvtss_f32(_mm_shuffle_ps(corner, corner, _MM_SHUFFLE(1, 1, 2, 3)));
+}
+
+
 bool testCollision(float *cell_mins, float *cell_maxs, __m128 prop_mins, __m128 prop_maxs) {
-    float prop_mins_x = _mm_cvtss_f32(prop_mins);
-    prop_mins = _mm_shuffle_ps(prop_mins, prop_mins, _MM_SHUFFLE(1, 1, 2, 3));
-    float prop_mins_y = _mm_cvtss_f32(prop_mins);
-    float prop_maxs_x = _mm_cvtss_f32(prop_maxs);
-    prop_maxs = _mm_shuffle_ps(prop_maxs, prop_maxs, _MM_SHUFFLE(1, 1, 2, 3));
-    float prop_maxs_y = _mm_cvtss_f32(prop_maxs);
+    float prop_mins_x, prop_mins_y, prop_maxs_x, prop_maxs_y;
+    collision_xy(prop_mins, prop_mins_x, prop_mins_y);
+    collision_xy(prop_maxs, prop_maxs_x, prop_maxs_y);
     if (((cell_mins[0] - 1) > prop_maxs_x) || ((cell_maxs[0] + 1) < prop_mins_x)) { return false; }
     if (((cell_mins[1] - 1) > prop_maxs_y) || ((cell_maxs[1] + 1) < prop_mins_y)) { return false; }
     return true;
@@ -66,6 +75,133 @@ titanfall::Bounds bounds_from_minmax(MinMax &mm) {
 }
 
 
+// NOTE: Bounds.sin & Bounds.cos are negated 1.15 fixed point
+// -- an axis-aligned box is {.sin = 0, .cos = -32768}, i.e. a yaw of 0
+int16_t quantise_rotation(float value) {
+    long quantised = lroundf(-value * 32768.0f);
+    return static_cast<int16_t>(std::clamp(quantised, -32768L, 32767L));
+}
+
+
+float dequantise_rotation(int16_t value) {
+    return static_cast<float>(value) / -32768.0f;
+}
+
+
+// world AABB around a (possibly yaw-oriented) Bounds
+MinMax minmax_from_bounds(const titanfall::Bounds &bounds) {
+    float s = fabsf(dequantise_rotation(bounds.sin));
+    float c = fabsf(dequantise_rotation(bounds.cos));
+    __m128 origin = _mm_set_ps(0, bounds.origin[2], bounds.origin[1], bounds.origin[0]);
+    __m128 half = _mm_set_ps(0, bounds.extents[2],
+        s * bounds.extents[0] + c * bounds.extents[1],
+        c * bounds.extents[0] + s * bounds.extents[1]);
+    MinMax mm;
+    mm.min = _mm_sub_ps(origin, half);
+    mm.max = _mm_add_ps(origin, half);
+    return mm;
+}
+
+
+// Z-order curve position of a Bounds' origin; nearby Bounds get nearby codes
+// -- each int16_t axis is offset to unsigned & its bits interleaved: x in bit 0, y in bit 1, z in bit 2, ...
+uint64_t morton_code(const titanfall::Bounds &bounds) {
+    auto spread = [](uint64_t v) {  // 16 bits -> every 3rd of 48 bits
+        v = (v | (v << 16)) & 0x0000FF0000FFull;
+        v = (v | (v <<  8)) & 0x00F00F00F00Full;
+        v = (v | (v <<  4)) & 0x0C30C30C30C3ull;
+        v = (v | (v <<  2)) & 0x249249249249ull;
+        return v;
+    };
+    uint64_t code = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        code |= spread(static_cast<uint16_t>(bounds.origin[axis] + 32768)) << axis;
+    }
+    return code;
+}
+
+
+// error introduced by quantising yaw into Bounds.sin & Bounds.cos
+struct QuantisationReport {
+    uint32_t  num_oriented     = 0;
+    uint32_t  num_axis_aligned = 0;  // pitched or rolled props can't be expressed w/ yaw alone
+    float     max_angle_error  = 0;  // radians
+    float     max_corner_error = 0;  // units; covered by padding extents
+
+    void print(FILE *out = stdout) {
+        fprintf(out, "Oriented prop bounds: %u oriented, %u axis-aligned\n", num_oriented, num_axis_aligned);
+        fprintf(out, "-- max yaw error: %f degrees, max corner error: %f units\n",
+            max_angle_error * 180.0f / 3.1415926536f, max_corner_error);
+    }
+};
+
+
+bool is_yaw_only(Vector3 angles) {
+    return fabsf(fmodf(angles.x, 360.0f)) < 0.01f && fabsf(fmodf(angles.z, 360.0f)) < 0.01f;
+}
+
+
+// everything bounds_from_yaw needs, except the prop origin
+struct YawTransform {
+    float    centre_cos[2];  // local space centre xy * cos(yaw)
+    float    centre_sin[2];  // local space centre xy * sin(yaw)
+    float    centre_z;
+    int16_t  sin_q, cos_q;
+    int16_t  extents[3];  // padded
+    float    angle_error, corner_error;
+};
+
+
+// only valid when is_yaw_only(angles)
+YawTransform yaw_transform(Vector3 mins, Vector3 maxs, float yaw, float scale) {
+    float radians = yaw * 3.1415926536f / 180.0f;
+    float sinVal = sinf(radians);
+    float cosVal = cosf(radians);
+    int16_t sin_q = quantise_rotation(sinVal);
+    int16_t cos_q = quantise_rotation(cosVal);
+
+    // local space centre & half extents
+    float centre[3] = {(mins.x + maxs.x) * 0.5f * scale, (mins.y + maxs.y) * 0.5f * scale, (mins.z + maxs.z) * 0.5f * scale};
+    float half[3]   = {(maxs.x - mins.x) * 0.5f * scale, (maxs.y - mins.y) * 0.5f * scale, (maxs.z - mins.z) * 0.5f * scale};
+
+    // worst case drift of a corner from the quantised rotation
+    float angle_error = fabsf(remainderf(atan2f(dequantise_rotation(sin_q), dequantise_rotation(cos_q)) - radians, 2 * 3.1415926536f));
+    float corner_error = angle_error * sqrtf(half[0] * half[0] + half[1] * half[1] + centre[0] * centre[0] + centre[1] * centre[1]);
+
+    // NOTE: we add 2 to each axis in extents to make sure we cover the full bounds
+    float padding = 2 + corner_error;
+    return {
+        .centre_cos   = {centre[0] * cosVal, centre[1] * cosVal},
+        .centre_sin   = {centre[0] * sinVal, centre[1] * sinVal},
+        .centre_z     = centre[2],
+        .sin_q        = sin_q,
+        .cos_q        = cos_q,
+        .extents      = {
+            static_cast<int16_t>(half[0] + padding),
+            static_cast<int16_t>(half[1] + padding),
+            static_cast<int16_t>(half[2] + padding)},
+        .angle_error  = angle_error,
+        .corner_error = corner_error};
+}
+
+
+// yaw-oriented Bounds for a scaled model bbox placed at origin
+titanfall::Bounds bounds_from_yaw(const YawTransform &transform, Vector3 origin, QuantisationReport &report) {
+    report.max_angle_error  = std::max(report.max_angle_error, transform.angle_error);
+    report.max_corner_error = std::max(report.max_corner_error, transform.corner_error);
+    report.num_oriented++;
+    titanfall::Bounds bounds = {
+        .origin = {
+            static_cast<int16_t>(origin.x + transform.centre_cos[0] - transform.centre_sin[1]),
+            static_cast<int16_t>(origin.y + transform.centre_sin[0] + transform.centre_cos[1]),
+            static_cast<int16_t>(origin.z + transform.centre_z)},
+        .sin = transform.sin_q,
+        .extents = {transform.extents[0], transform.extents[1], transform.extents[2]},
+        .cos = transform.cos_q};
+    return bounds;
+}
+
+
 __m128 rotate(const __m128 &vec, Vector3 angles) {
     __m128 res = vec;
     float cosVal = cos(angles.x);
@@ -89,6 +225,31 @@ __m128 rotate(const __m128 &vec, Vector3 angles) {
 }
 
 
+// rotated & scaled model bounds, relative to the prop origin
+// -- float addition rounds monotonically, so adding the origin to min & max after
+// -- matches adding it to each corner, bit for bit
+MinMax minmax_from_local_bounds(Vector3 mins, Vector3 maxs, Vector3 angles, __m128 scale) {
+    MinMax mm;
+    mm.addVector(rotate(_mm_mul_ps(_mm_set_ps(0, mins.z, mins.y, mins.x), scale), angles));
+    mm.addVector(rotate(_mm_mul_ps(_mm_set_ps(0, mins.z, mins.y, maxs.x), scale), angles));
+    mm.addVector(rotate(_mm_mul_ps(_mm_set_ps(0, mins.z, maxs.y, mins.x), scale), angles));
+    mm.addVector(rotate(_mm_mul_ps(_mm_set_ps(0, mins.z, maxs.y, maxs.x), scale), angles));
+    mm.addVector(rotate(_mm_mul_ps(_mm_set_ps(0, maxs.z, mins.y, mins.x), scale), angles));
+    mm.addVector(rotate(_mm_mul_ps(_mm_set_ps(0, maxs.z, mins.y, maxs.x), scale), angles));
+    mm.addVector(rotate(_mm_mul_ps(_mm_set_ps(0, maxs.z, maxs.y, mins.x), scale), angles));
+    mm.addVector(rotate(_mm_mul_ps(_mm_set_ps(0, maxs.z, maxs.y, maxs.x), scale), angles));
+    return mm;
+}
+
+
+MinMax translate(const MinMax &local, __m128 origin) {
+    MinMax mm;
+    mm.min = _mm_add_ps(origin, local.min);
+    mm.max = _mm_add_ps(origin, local.max);
+    return mm;
+}
+
+
 MinMax minmax_from_instance_bounds(Vector3 mins, Vector3 maxs, __m128 origin, Vector3 angles, __m128 scale) {
     MinMax mm;
     mm.addVector(_mm_add_ps(origin, rotate(_mm_mul_ps(_mm_set_ps(0, mins.z, mins.y, mins.x), scale), angles)));
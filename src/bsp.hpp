@@ -5,9 +5,11 @@
 #include <fstream>
 #include <span>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 #include "common.hpp"
+#include "compressed.hpp"
 #include "memory_mapped_file.hpp"
 
 
@@ -48,9 +50,24 @@ class Bsp { public:
     BspHeader          *header_;
     memory_mapped_file  file_;
 
-    Bsp(const char* filename) {  // load from file
+    compressed::Format  compression_ = compressed::Format::NONE;  // of the file or buffer it was loaded from
+
+    Bsp(const char* filename) {  // load from file, which may be zstd or xz compressed
         if (!file_.open_existing(filename))
             throw std::runtime_error("Failed to open file");
+        decompress();
+        if (file_.size() < sizeof(BspHeader))
+            throw std::runtime_error("File is too small to be a .bsp");
+        header_ = file_.rawdata<BspHeader>();
+    }
+
+    // view of a .bsp already in memory, which must outlive the Bsp
+    // -- unless it's compressed, then it's decompressed into memory the Bsp owns
+    Bsp(const char* data, size_t size) {
+        file_.open_memory(const_cast<char*>(data), size);
+        decompress();
+        if (file_.size() < sizeof(BspHeader))
+            throw std::runtime_error("File is too small to be a .bsp");
         header_ = file_.rawdata<BspHeader>();
     }
 
@@ -71,11 +88,20 @@ class Bsp { public:
         }
     }
 
+    // throws if a lump's LumpHeader points outside the file
+    // -- every accessor below checks, since offsets & lengths come straight from the file
+    void check_lump(const int lump_index) {
+        auto &lump_header = header_->lumps[lump_index];
+        if (lump_header.offset > file_.size() || lump_header.length > file_.size() - lump_header.offset)
+            throw std::runtime_error("Lump " + std::to_string(lump_index) + " is outside the file");
+    }
+
     template <typename T>
     void load_lump(const int lump_index, std::vector<T> &lump_vector) {
+        check_lump(lump_index);
         auto &lump_header = header_->lumps[lump_index];
         auto *lump_data = file_.rawdata<T>(lump_header.offset);
-        lump_vector.assign(lump_data, lump_data[lump_header.length / sizeof(T)]);
+        lump_vector.assign(lump_data, lump_data + lump_header.length / sizeof(T));
     }
 
     template<size_t N>
@@ -84,6 +110,7 @@ class Bsp { public:
     }
 
     void load_lump_raw(const int lump_index, char* raw_lump, size_t raw_lump_size) {
+        check_lump(lump_index);
         auto &lump_header = header_->lumps[lump_index];
         memcpy_s(raw_lump, raw_lump_size, file_.rawdata(lump_header.offset), lump_header.length);
     }
@@ -97,12 +124,14 @@ class Bsp { public:
 
     template <typename T>
     std::span<T> get_lump(const int lump_index) {
+        check_lump(lump_index);
         auto &lump_header = header_->lumps[lump_index];
         return { file_.rawdata<T>(lump_header.offset), lump_header.length / sizeof(T) };
     }
 
     template <typename T>
     T *get_lump_raw(const int lump_index) {
+        check_lump(lump_index);
         auto &lump_header = header_->lumps[lump_index];
         return file_.rawdata<T>(lump_header.offset);
     }
@@ -110,4 +139,14 @@ class Bsp { public:
     int get_lump_length(const int lump_index) {
         return header_->lumps[lump_index].length;
     }
+
+  private:
+    // swaps a compressed file_ for an anonymous mapping of its contents
+    void decompress() {
+        compression_ = compressed::detect(file_.rawdata(), file_.size());
+        if (compression_ == compressed::Format::NONE) { return; }
+        memory_mapped_file decompressed;
+        compressed::decompress(compression_, file_.rawdata(), file_.size(), decompressed);
+        file_.swap(decompressed);
+    }
 };
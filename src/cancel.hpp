@@ -0,0 +1,59 @@
+// abandoning long conversions: a ConversionContext is checked at stage & chunk boundaries
+// -- cancel() (from any thread) or a passed deadline makes the next check throw Cancelled
+// -- progress is reported per stage, as the fraction of that stage done
+// NOTE: an abandoned conversion removes its partial output, see ~OutputFile
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+
+class Cancelled : public std::runtime_error { public:
+    bool  timed_out_;  // the deadline passed, rather than cancel() being called
+
+    Cancelled(const char *stage, bool timed_out)
+        : std::runtime_error(std::string(timed_out ? "Conversion timed out" : "Conversion cancelled") + " during " + stage),
+          timed_out_(timed_out) {}
+};
+
+
+class ConversionContext { public:
+    typedef std::chrono::steady_clock Clock;
+
+    Clock::time_point  deadline_ = Clock::time_point::max();
+    // stage, fraction of it done [0, 1]; called from worker threads, but never by 2 at once
+    std::function<void(const char *stage, float fraction)>  progress_;
+
+    void cancel() { cancelled_ = true; }
+
+    void setTimeout(Clock::duration timeout) { deadline_ = Clock::now() + timeout; }
+
+    void check(const char *stage) const {
+        if (cancelled_) { throw Cancelled(stage, false); }
+        if (deadline_ != Clock::time_point::max() && Clock::now() >= deadline_) { throw Cancelled(stage, true); }
+    }
+
+    void progress(const char *stage, float fraction) {
+        if (!progress_) { return; }
+        std::lock_guard<std::mutex> lock(mutex_);
+        progress_(stage, fraction);
+    }
+
+  private:
+    std::atomic<bool>  cancelled_ = false;
+    std::mutex         mutex_;
+};
+
+
+// NOTE: both do nothing w/o a context, so every stage can call them
+void checkCancelled(const ConversionContext *context, const char *stage) {
+    if (context != nullptr) { context->check(stage); }
+}
+
+void reportProgress(ConversionContext *context, const char *stage, float fraction) {
+    if (context != nullptr) { context->progress(stage, fraction); }
+}
@@ -0,0 +1,247 @@
+// CPU collision queries over a CM grid, for verifying & benchmarking converted maps
+// NOTE: primitives are only tested against their Bounds, not brush / tricoll / prop geometry
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+#include "bounds.hpp"  // dequantise_rotation
+#include "bsp.hpp"
+#include "titanfall.hpp"
+
+
+namespace cm {
+    struct QueryStats {
+        uint64_t  queries           = 0;
+        uint64_t  cells_visited     = 0;
+        uint64_t  geo_sets_visited  = 0;
+        uint64_t  primitives_tested = 0;
+        uint64_t  primitives_hit    = 0;
+        uint64_t  lines_touched     = 0;  // distinct 64 byte lines of CM_GRID lumps read; only w/ Grid::trace_lines_
+    };
+
+
+    struct Ray {
+        Vector3  start;
+        Vector3  end;
+    };
+
+
+    // NOTE: primitive is a bitfield, see titanfall::GeoSet
+    uint32_t primitive_type(uint32_t primitive)  { return primitive >> 24; }
+    uint32_t primitive_index(uint32_t primitive) { return (primitive >> 8) & 0xFFFF; }
+
+
+    // world space AABB overlap w/ a (possibly yaw-oriented) Bounds
+    bool testBounds(const titanfall::Bounds &bounds, const Vector3 &mins, const Vector3 &maxs) {
+        float s = fabsf(dequantise_rotation(bounds.sin));
+        float c = fabsf(dequantise_rotation(bounds.cos));
+        float half[3] = {
+            c * bounds.extents[0] + s * bounds.extents[1],
+            s * bounds.extents[0] + c * bounds.extents[1],
+            static_cast<float>(bounds.extents[2])};
+        if (bounds.origin[0] - half[0] > maxs.x || bounds.origin[0] + half[0] < mins.x) { return false; }
+        if (bounds.origin[1] - half[1] > maxs.y || bounds.origin[1] + half[1] < mins.y) { return false; }
+        if (bounds.origin[2] - half[2] > maxs.z || bounds.origin[2] + half[2] < mins.z) { return false; }
+        return true;
+    }
+
+
+    // segment vs. oriented Bounds; ray is moved into the Bounds' local space
+    bool testBounds(const titanfall::Bounds &bounds, const Ray &ray) {
+        float s = dequantise_rotation(bounds.sin);
+        float c = dequantise_rotation(bounds.cos);
+        float dx = ray.start.x - bounds.origin[0];
+        float dy = ray.start.y - bounds.origin[1];
+        float ex = ray.end.x - ray.start.x;
+        float ey = ray.end.y - ray.start.y;
+        float start[3] = { dx * c + dy * s, -dx * s + dy * c, ray.start.z - bounds.origin[2]};
+        float delta[3] = { ex * c + ey * s, -ex * s + ey * c, ray.end.z - ray.start.z};
+        float t_min = 0, t_max = 1;
+        for (int axis = 0; axis < 3; axis++) {
+            float extent = bounds.extents[axis];
+            if (fabsf(delta[axis]) < 1e-6f) {
+                if (start[axis] < -extent || start[axis] > extent) { return false; }
+                continue;
+            }
+            float t0 = (-extent - start[axis]) / delta[axis];
+            float t1 = ( extent - start[axis]) / delta[axis];
+            if (t0 > t1) { std::swap(t0, t1); }
+            t_min = std::max(t_min, t0);
+            t_max = std::min(t_max, t1);
+            if (t_min > t_max) { return false; }
+        }
+        return true;
+    }
+
+
+    class Grid { public:
+        titanfall::Grid                   grid_;
+        std::vector<titanfall::GridCell>  cells_;
+        std::vector<titanfall::GeoSet>    geo_sets_;
+        std::vector<titanfall::Bounds>    geo_set_bounds_;
+        std::vector<uint32_t>             primitives_;
+        std::vector<titanfall::Bounds>    primitive_bounds_;
+        // straddle groups are walked in the first cell a query reaches them from
+        std::vector<uint64_t>             straddle_stamps_;
+        std::vector<int>                  straddle_cells_;
+        uint64_t                          stamp_ = 0;
+        // count the cache lines each query reads, into QueryStats::lines_touched (slow; off for timing)
+        bool                              trace_lines_ = false;
+        std::unordered_set<uintptr_t>     lines_;
+
+        Grid(Bsp &bsp) {
+            grid_ = bsp.get_lump<titanfall::Grid>(titanfall::CM_GRID)[0];
+            auto cells     = bsp.get_lump<titanfall::GridCell>(titanfall::CM_GRID_CELLS);
+            auto geo_sets  = bsp.get_lump<titanfall::GeoSet>  (titanfall::CM_GEO_SETS);
+            auto gs_bounds = bsp.get_lump<titanfall::Bounds>  (titanfall::CM_GEO_SET_BOUNDS);
+            auto prims     = bsp.get_lump<uint32_t>           (titanfall::CM_PRIMITIVES);
+            auto pr_bounds = bsp.get_lump<titanfall::Bounds>  (titanfall::CM_PRIMITIVE_BOUNDS);
+            cells_.assign(cells.begin(), cells.end());
+            geo_sets_.assign(geo_sets.begin(), geo_sets.end());
+            geo_set_bounds_.assign(gs_bounds.begin(), gs_bounds.end());
+            primitives_.assign(prims.begin(), prims.end());
+            primitive_bounds_.assign(pr_bounds.begin(), pr_bounds.end());
+            straddle_stamps_.assign(static_cast<size_t>(grid_.num_straddle_groups) + 1, 0);
+            straddle_cells_.assign(straddle_stamps_.size(), -1);
+        }
+
+        int numWorldCells() {
+            return grid_.num_cells[0] * grid_.num_cells[1];
+        }
+
+        // world space bounds of the worldspawn cells
+        void extents(Vector3 &mins, Vector3 &maxs) {
+            mins = {grid_.cell_offset[0] * grid_.scale, grid_.cell_offset[1] * grid_.scale, -16384};
+            maxs = {
+                (grid_.cell_offset[0] + grid_.num_cells[0]) * grid_.scale,
+                (grid_.cell_offset[1] + grid_.num_cells[1]) * grid_.scale, 16384};
+        }
+
+        // appends each primitive whose Bounds overlap [mins, maxs] to hits
+        void queryBox(const Vector3 &mins, const Vector3 &maxs, std::vector<uint32_t> &hits, QueryStats &stats) {
+            stats.queries++;
+            stamp_++;
+            lines_.clear();
+            int x0 = cellCoord(mins.x, 0), x1 = cellCoord(maxs.x, 0);
+            int y0 = cellCoord(mins.y, 1), y1 = cellCoord(maxs.y, 1);
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    walkCell(y * grid_.num_cells[0] + x, stats, hits,
+                        [&](const titanfall::Bounds &b) { return testBounds(b, mins, maxs); });
+                }
+            }
+            stats.lines_touched += lines_.size();
+        }
+
+        // appends each primitive whose Bounds the segment passes through to hits
+        // -- cells are stepped along the segment in XY (2D DDA)
+        void queryRay(const Ray &ray, std::vector<uint32_t> &hits, QueryStats &stats) {
+            stats.queries++;
+            stamp_++;
+            lines_.clear();
+            auto test = [&](const titanfall::Bounds &b) { return testBounds(b, ray); };
+            float start[2] = {ray.start.x / grid_.scale - grid_.cell_offset[0], ray.start.y / grid_.scale - grid_.cell_offset[1]};
+            float delta[2] = {(ray.end.x - ray.start.x) / grid_.scale, (ray.end.y - ray.start.y) / grid_.scale};
+            int cell[2], last[2], step[2];
+            float t_next[2], t_delta[2];
+            for (int axis = 0; axis < 2; axis++) {
+                cell[axis] = static_cast<int>(floorf(start[axis]));
+                last[axis] = static_cast<int>(floorf(start[axis] + delta[axis]));
+                step[axis] = delta[axis] > 0 ? 1 : -1;
+                if (delta[axis] == 0) {
+                    t_next[axis] = t_delta[axis] = std::numeric_limits<float>::max();
+                } else {
+                    float boundary = step[axis] > 0 ? cell[axis] + 1 : static_cast<float>(cell[axis]);
+                    t_next[axis]  = (boundary - start[axis]) / delta[axis];
+                    t_delta[axis] = step[axis] / delta[axis];
+                }
+            }
+            while (true) {
+                if (cell[0] >= 0 && cell[0] < grid_.num_cells[0] && cell[1] >= 0 && cell[1] < grid_.num_cells[1]) {
+                    walkCell(cell[1] * grid_.num_cells[0] + cell[0], stats, hits, test);
+                }
+                if (cell[0] == last[0] && cell[1] == last[1]) { break; }
+                int axis = t_next[0] < t_next[1] ? 0 : 1;
+                if (t_next[axis] > 1) { break; }
+                cell[axis] += step[axis];
+                t_next[axis] += t_delta[axis];
+            }
+            stats.lines_touched += lines_.size();
+        }
+
+        // mark each GAME_LUMP.sprp.props index referenced by a prop Primitive
+        std::vector<bool> reachableProps(size_t num_props) {
+            std::vector<bool> reachable(num_props, false);
+            auto mark = [&](uint32_t primitive) {
+                if (primitive_type(primitive) == titanfall::PROP && primitive_index(primitive) < num_props) {
+                    reachable[primitive_index(primitive)] = true;
+                }
+            };
+            for (titanfall::GridCell &cell : cells_) {
+                for (uint32_t i = 0; i < cell.num_geo_sets; i++) {
+                    titanfall::GeoSet &geo_set = geo_sets_[cell.first_geo_set + i];
+                    if (geo_set.num_primitives == 1) {
+                        mark(geo_set.primitive);
+                        continue;
+                    }
+                    uint32_t first = primitive_index(geo_set.primitive);
+                    for (uint32_t j = 0; j < geo_set.num_primitives; j++) {
+                        mark(primitives_[first + j]);
+                    }
+                }
+            }
+            return reachable;
+        }
+
+    private:
+        int cellCoord(float world, int axis) {
+            int cell = static_cast<int>(floorf(world / grid_.scale)) - grid_.cell_offset[axis];
+            return std::clamp(cell, 0, grid_.num_cells[axis] - 1);
+        }
+
+        void touch(const void *address) {
+            if (trace_lines_) { lines_.insert(reinterpret_cast<uintptr_t>(address) >> 6); }
+        }
+
+        template <typename Test>
+        void walkCell(int cell_index, QueryStats &stats, std::vector<uint32_t> &hits, Test test) {
+            stats.cells_visited++;
+            titanfall::GridCell &cell = cells_[cell_index];
+            touch(&cell);
+            for (uint32_t i = 0; i < cell.num_geo_sets; i++) {
+                uint32_t geo_set_index = cell.first_geo_set + i;
+                titanfall::GeoSet &geo_set = geo_sets_[geo_set_index];
+                touch(&geo_set);
+                uint16_t group = geo_set.straddle_group;
+                if (group != 0 && group < straddle_stamps_.size()) {
+                    if (straddle_stamps_[group] == stamp_ && straddle_cells_[group] != cell_index) { continue; }
+                    straddle_stamps_[group] = stamp_;
+                    straddle_cells_[group]  = cell_index;
+                }
+                stats.geo_sets_visited++;
+                touch(&geo_set_bounds_[geo_set_index]);
+                if (!test(geo_set_bounds_[geo_set_index])) { continue; }
+                if (geo_set.num_primitives == 1) {
+                    stats.primitives_tested++;
+                    stats.primitives_hit++;
+                    hits.push_back(geo_set.primitive);
+                    continue;
+                }
+                uint32_t first = primitive_index(geo_set.primitive);
+                for (uint32_t j = 0; j < geo_set.num_primitives; j++) {
+                    stats.primitives_tested++;
+                    touch(&primitive_bounds_[first + j]);
+                    if (test(primitive_bounds_[first + j])) {
+                        touch(&primitives_[first + j]);
+                        stats.primitives_hit++;
+                        hits.push_back(primitives_[first + j]);
+                    }
+                }
+            }
+        }
+    };
+};
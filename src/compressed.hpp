@@ -0,0 +1,211 @@
+// compressed input maps: zstd & xz are decompressed straight into an anonymous mapping, w/o a temporary file
+// -- each codec is only built in w/ BSP_REGEN_HAVE_ZSTD / BSP_REGEN_HAVE_LZMA (see CMakeLists.txt)
+// -- the decompressed size comes from the frame headers (zstd) or the stream index (xz), so the mapping is
+//    allocated once & decoded into in place; streams that don't record it are decoded into a growing buffer
+// NOTE: the whole map is decoded up front; lumps are read through raw pointers everywhere, so can't be faulted in
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef BSP_REGEN_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef BSP_REGEN_HAVE_LZMA
+#include <lzma.h>
+#endif
+
+#include "memory_mapped_file.hpp"
+
+
+namespace compressed {
+    enum class Format { NONE, ZSTD, XZ };
+
+    // lump offsets are 32-bit, so no .bsp is bigger; also caps what a hostile header can make us allocate
+    const uint64_t MAX_SIZE = 1ull << 32;
+
+    const char *format_name(Format format) {
+        switch (format) {
+            case Format::ZSTD:  return "zstd";
+            case Format::XZ:    return "xz";
+            default:            return "none";
+        }
+    }
+
+    // by magic number
+    Format detect(const char *data, size_t size) {
+        static const unsigned char ZSTD_MAGIC[4] = {0x28, 0xB5, 0x2F, 0xFD};
+        static const unsigned char XZ_MAGIC[6]   = {0xFD, '7', 'z', 'X', 'Z', 0x00};
+        if (size >= sizeof(ZSTD_MAGIC) && memcmp(data, ZSTD_MAGIC, sizeof(ZSTD_MAGIC)) == 0) { return Format::ZSTD; }
+        if (size >= sizeof(XZ_MAGIC) && memcmp(data, XZ_MAGIC, sizeof(XZ_MAGIC)) == 0) { return Format::XZ; }
+        return Format::NONE;
+    }
+
+    bool supported(Format format) {
+        switch (format) {
+#ifdef BSP_REGEN_HAVE_ZSTD
+            case Format::ZSTD:  return true;
+#endif
+#ifdef BSP_REGEN_HAVE_LZMA
+            case Format::XZ:    return true;
+#endif
+            default:            return false;
+        }
+    }
+
+
+    // where decoded bytes go: the final mapping if its size is known, else a buffer copied into one at the end
+    class Output { public:
+        Output(memory_mapped_file &out, uint64_t known_size) : out_(out), known_(known_size != 0) {
+            if (known_size > MAX_SIZE) { throw std::runtime_error("Compressed map is too big to be a .bsp"); }
+            if (known_) { out_.open_anonymous(static_cast<size_t>(known_size)); }
+        }
+
+        // room for more output; none once a known size is full
+        char *next(size_t &available) {
+            if (known_) {
+                available = out_.size() - used_;
+                return out_.rawdata(used_);
+            }
+            if (used_ == buffer_.size()) {
+                if (used_ >= MAX_SIZE) { throw std::runtime_error("Compressed map is too big to be a .bsp"); }
+                buffer_.resize(std::max<size_t>(1 << 20, buffer_.size() * 2));
+            }
+            available = buffer_.size() - used_;
+            return buffer_.data() + used_;
+        }
+
+        void produced(size_t length) { used_ += length; }
+
+        bool full() { return known_ && used_ == out_.size(); }
+
+        void finish() {
+            if (known_) {
+                if (used_ != out_.size()) { throw std::runtime_error("Compressed map is shorter than its header says"); }
+                return;
+            }
+            if (used_ == 0) { throw std::runtime_error("Compressed map is empty"); }
+            out_.open_anonymous(used_);
+            memcpy(out_.rawdata(), buffer_.data(), used_);
+        }
+
+      private:
+        memory_mapped_file  &out_;
+        bool                 known_;
+        size_t               used_ = 0;
+        std::vector<char>    buffer_;  // only if the size isn't known
+    };
+
+
+#ifdef BSP_REGEN_HAVE_ZSTD
+    // every frame's content size summed, or ZSTD_CONTENTSIZE_UNKNOWN if any frame doesn't record its own
+    // -- as ZSTD_findDecompressedSize, which is only declared w/ ZSTD_STATIC_LINKING_ONLY (the experimental API)
+    unsigned long long zstd_content_size(const char *data, size_t size) {
+        unsigned long long total = 0;
+        bool known = true;
+        while (size > 0) {
+            unsigned long long frame = ZSTD_getFrameContentSize(data, size);
+            if (frame == ZSTD_CONTENTSIZE_ERROR) { return ZSTD_CONTENTSIZE_ERROR; }
+            size_t compressed = ZSTD_findFrameCompressedSize(data, size);
+            if (ZSTD_isError(compressed)) { return ZSTD_CONTENTSIZE_ERROR; }
+            if (frame == ZSTD_CONTENTSIZE_UNKNOWN || total + frame < total) {
+                known = false;
+            } else {
+                total += frame;
+            }
+            data += compressed;
+            size -= compressed;
+        }
+        return known ? total : ZSTD_CONTENTSIZE_UNKNOWN;
+    }
+
+    void decompress_zstd(const char *data, size_t size, memory_mapped_file &out) {
+        unsigned long long known = zstd_content_size(data, size);
+        if (known == ZSTD_CONTENTSIZE_ERROR) { throw std::runtime_error("Invalid zstd frame"); }
+        Output output(out, known == ZSTD_CONTENTSIZE_UNKNOWN ? 0 : known);
+        ZSTD_DStream *stream = ZSTD_createDStream();
+        ZSTD_inBuffer in = {data, size, 0};
+        size_t ret = 0;
+        while (in.pos < in.size) {
+            size_t available;
+            char *dst = output.next(available);
+            size_t consumed = in.pos;
+            ZSTD_outBuffer out_buffer = {dst, available, 0};
+            ret = ZSTD_decompressStream(stream, &out_buffer, &in);
+            output.produced(out_buffer.pos);
+            if (ZSTD_isError(ret)) {
+                ZSTD_freeDStream(stream);
+                throw std::runtime_error(std::string("zstd: ") + ZSTD_getErrorName(ret));
+            }
+            if (available == 0 && in.pos == consumed) { break; }  // the mapping is full, but the frames go on
+        }
+        ZSTD_freeDStream(stream);
+        if (ret != 0 || in.pos != in.size) { throw std::runtime_error("zstd: truncated or trailing data"); }
+        output.finish();
+    }
+#endif
+
+
+#ifdef BSP_REGEN_HAVE_LZMA
+    // from the index at the end of a single .xz stream; 0 if it can't be read (e.g. concatenated streams)
+    uint64_t xz_size(const uint8_t *data, size_t size) {
+        if (size < 2 * LZMA_STREAM_HEADER_SIZE) { return 0; }
+        lzma_stream_flags footer;
+        if (lzma_stream_footer_decode(&footer, data + size - LZMA_STREAM_HEADER_SIZE) != LZMA_OK) { return 0; }
+        if (footer.backward_size > size - 2 * LZMA_STREAM_HEADER_SIZE) { return 0; }
+        lzma_index *index = nullptr;
+        uint64_t memlimit = UINT64_MAX;
+        size_t position = 0;
+        const uint8_t *start = data + size - LZMA_STREAM_HEADER_SIZE - footer.backward_size;
+        if (lzma_index_buffer_decode(&index, &memlimit, nullptr, start, &position, footer.backward_size) != LZMA_OK) { return 0; }
+        uint64_t total = lzma_index_stream_size(index) == size ? lzma_index_uncompressed_size(index) : 0;
+        lzma_index_end(index, nullptr);
+        return total;
+    }
+
+    void decompress_xz(const char *data, size_t size, memory_mapped_file &out) {
+        const uint8_t *bytes = reinterpret_cast<const uint8_t*>(data);
+        Output output(out, xz_size(bytes, size));
+        lzma_stream stream = LZMA_STREAM_INIT;
+        if (lzma_stream_decoder(&stream, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK) {
+            throw std::runtime_error("xz: couldn't start the decoder");
+        }
+        stream.next_in = bytes;
+        stream.avail_in = size;
+        lzma_ret ret = LZMA_OK;
+        while (ret == LZMA_OK) {
+            size_t available;
+            char *dst = output.next(available);
+            stream.next_out = reinterpret_cast<uint8_t*>(dst);
+            stream.avail_out = available;
+            ret = lzma_code(&stream, LZMA_FINISH);
+            output.produced(available - stream.avail_out);
+        }
+        lzma_end(&stream);
+        if (ret != LZMA_STREAM_END) {
+            // NOTE: LZMA_BUF_ERROR once the mapping is full means the stream holds more than its index says
+            throw std::runtime_error("xz: " + std::string(output.full() ? "more data than its index says" : "corrupt or truncated stream")
+                + " (" + std::to_string(ret) + ")");
+        }
+        output.finish();
+    }
+#endif
+
+
+    // decodes a whole compressed map into out (an anonymous mapping); throws if the codec isn't built in
+    void decompress(Format format, const char *data, size_t size, memory_mapped_file &out) {
+        if (!supported(format)) {
+            throw std::runtime_error(std::string("This build can't read ") + format_name(format) + " compressed maps");
+        }
+#ifdef BSP_REGEN_HAVE_ZSTD
+        if (format == Format::ZSTD) { decompress_zstd(data, size, out); }
+#endif
+#ifdef BSP_REGEN_HAVE_LZMA
+        if (format == Format::XZ) { decompress_xz(data, size, out); }
+#endif
+    }
+};
@@ -0,0 +1,1143 @@
+// Titanfall -> Titanfall 2 .bsp conversion
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <immintrin.h>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <set>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "alloc_stats.hpp"
+#include "bounds.hpp"
+#include "bsp.hpp"
+#include "cancel.hpp"
+#include "game_lump.hpp"
+#include "grid_tuning.hpp"
+#include "hash.hpp"
+#include "lumps.hpp"
+#include "memory_mapped_file.hpp"
+#include "models.hpp"
+#include "output_file.hpp"
+#include "perf_counters.hpp"
+#include "output_cache.hpp"
+#include "prop_transforms.hpp"
+#include "source.hpp"  // GameLumpHeader
+#include "tasks.hpp"
+#include "titanfall.hpp"
+#include "titanfall2.hpp"
+#include "tricoll.hpp"
+
+
+struct ConvertOptions {
+    unsigned     num_threads  = 1;
+    bool         alloc_stats  = false;
+    bool         perf_counters = false;  // per stage, into ConversionReport::perf
+    bool         print_report = true;
+    bool         verify       = false;  // decode & compare the r1 & r2 tricoll bevels once written
+    bool         write_hashes = true;  // per-lump & file digests, to <out>.hashes
+    const char  *model_dir    = "r1";  // search path for the .mdl files the map uses
+    // path of each .mdl, by its name in the GAME_LUMP; overrides model_dir if set
+    std::function<std::string(const std::string &name)>  model_resolver;
+    const char  *cache_dir    = nullptr;  // OutputCache directory, if any
+    uint64_t     cache_size   = 4ull << 30;  // bytes, before the least recently used entries are evicted
+    // lumps written to <out>.<index>.bsp_lump files instead of the .bsp
+    std::bitset<128>  external_lumps;
+    uint32_t          external_threshold = 0;  // bytes, any lump at least this long is external; 0 for none
+    IoBackend         io = IoBackend::MMAP;
+    // if set, the .bsp is built here instead of at out_filename (w/o a .hashes, .bsp_lump files or caching)
+    std::vector<char> *output_memory = nullptr;
+    // if set, the .bsp is streamed here front to back instead (pipes, stdout); out_filename only names the .hashes
+    // -- while this is stdout, the report & --alloc-stats go to stderr
+    int                output_fd = -1;
+    ModelCache        *model_cache = nullptr;  // reuse model metadata across conversions, if set
+    // worldspawn CM grid cell size; 0 keeps r1's Grid, grid_tuning::AUTO picks one w/ the cost model
+    float              cm_grid_scale = 0;
+    // emit prop GeoSets & their child Primitives in Morton order of their bounds, instead of straddle group order
+    bool               morton_order = false;
+    // per-tri AABB tree levels each prop's GridCells are footprinted against; 0 uses only its bounds, as r1 does
+    // NOTE: the tree's node layout is inferred, see mstudiopertrinode_t
+    int                footprint_depth = 0;
+    ConversionContext *context = nullptr;  // cancellation, deadline & progress callback, if set
+};
+
+
+// how close the generated CM_GRID lumps come to the limits of their index fields
+struct CapacityReport {
+    static constexpr uint32_t MAX_UNIQUE_CONTENTS = 0x100;  // Primitive & GeoSet unique_contents are 8 bits
+    static constexpr uint32_t MAX_GEO_SETS        = 0xFFFF;  // GridCell.first_geo_set is 16 bits
+    static constexpr uint32_t MAX_STRADDLE_GROUPS = 0x10000;  // GeoSet.straddle_group is 16 bits
+    static constexpr uint32_t MAX_INDEX           = 0xFFFF;  // Primitive index is 16 bits (index << 8)
+
+    uint32_t  unique_contents     = 0;
+    uint32_t  geo_sets            = 0;
+    uint32_t  r1_straddle_groups  = 0;
+    uint32_t  straddle_groups     = 0;
+    uint32_t  max_prop_index      = 0;  // of any prop Primitive
+    uint32_t  max_first_primitive = 0;  // of any GeoSet w/ more than 1 prop
+
+    // the first limit exceeded, or "" if none
+    std::string exceeded() const {
+        auto over = [](const char *what, uint32_t value, uint32_t limit) {
+            return what + std::string(" too big: ") + std::to_string(value) + " > " + std::to_string(limit);
+        };
+        if (unique_contents > MAX_UNIQUE_CONTENTS)     { return over("UniqueContents", unique_contents, MAX_UNIQUE_CONTENTS); }
+        if (geo_sets > MAX_GEO_SETS)                   { return over("Geosets", geo_sets, MAX_GEO_SETS); }
+        if (straddle_groups > MAX_STRADDLE_GROUPS)     { return over("Straddle groups", straddle_groups, MAX_STRADDLE_GROUPS); }
+        if (max_prop_index > MAX_INDEX)                { return over("Prop index", max_prop_index, MAX_INDEX); }
+        if (max_first_primitive > MAX_INDEX)           { return over("Primitive index", max_first_primitive, MAX_INDEX); }
+        return "";
+    }
+};
+
+
+// stats gathered during conversion, printed at the end
+struct ConversionReport {
+    QuantisationReport  quantisation;
+    uint32_t            cells_touched_by_bounds    = 0;
+    uint32_t            cells_touched_by_footprint = 0;  // only if ConvertOptions::footprint_depth is set
+    uint32_t            transform_cache_hits   = 0;
+    uint32_t            transform_cache_misses = 0;
+    bool                verified = false;
+    tricoll::VerifyReport  tricoll;  // only if verified
+    CapacityReport      capacity;
+    grid_tuning::Report  grid_tuning;  // only if ConvertOptions::cm_grid_scale is set
+    uint64_t            lump_hashes[128] = {};  // hash::hash64 of each lump as written; 0 if absent
+    uint64_t            file_hash = 0;
+    IoBackend           io = IoBackend::MMAP;  // after any fallback
+    bool                measured = false;
+    perf_counters::Report  perf;  // only if measured
+
+    void print(FILE *out = stdout) {
+        quantisation.print(out);
+        if (cells_touched_by_footprint != 0) {
+            fprintf(out, "Per-tri AABB footprints: %u of %u GridCells touched by prop bounds\n",
+                cells_touched_by_footprint, cells_touched_by_bounds);
+        }
+        uint32_t lookups = transform_cache_hits + transform_cache_misses;
+        fprintf(out, "Prop transform cache: %u hits, %u misses (%.1f%% hit rate)\n", transform_cache_hits, transform_cache_misses,
+            lookups ? 100.0 * transform_cache_hits / lookups : 0.0);
+        grid_tuning.print(out);
+        if (verified) { tricoll.print(out); }
+        char hex[17];
+        hash::to_hex(file_hash, hex);
+        fprintf(out, "Output digest: %s\n", hex);
+        fprintf(out, "Output I/O: %s\n", io_backend_name(io));
+        if (measured) { perf.print(out); }
+    }
+};
+
+
+// where to load a model from
+std::string modelPath(const ConvertOptions &options, const ModelDictEntry &entry) {
+    // NOTE: names aren't always null terminated
+    std::string name(entry, strnlen(entry, sizeof(ModelDictEntry)));
+    return options.model_resolver ? options.model_resolver(name) : std::string(options.model_dir) + "/" + name;
+}
+
+
+void addPropsToCmGrid(
+    Bsp                                 &r1bsp,
+    GameLumpView<titanfall::StaticProp> &gameLump,
+    titanfall::Grid                     &r2Grid,
+    std::vector<titanfall::GridCell>    &r2GridCells,
+    std::vector<titanfall::GeoSet>      &r2GeoSets,
+    std::vector<titanfall::Bounds>      &r2GeoSetBounds,
+    std::vector<uint32_t>               &r2Primitives,
+    std::vector<titanfall::Bounds>      &r2PrimitiveBounds,
+    std::vector<uint32_t>               &r2Contents,
+    const ConvertOptions                &options,
+    ConversionReport                    &report,
+    std::pmr::memory_resource           *arena,
+    bool                                 enforce_limits = true) {  // false to measure how far past them a map goes
+
+    auto r1GridLump        = r1bsp.get_lump<titanfall::Grid>    (titanfall::CM_GRID);
+    auto r1GridCells       = r1bsp.get_lump<titanfall::GridCell>(titanfall::CM_GRID_CELLS);
+    auto r1GeoSets         = r1bsp.get_lump<titanfall::GeoSet>  (titanfall::CM_GEO_SETS);
+    auto r1GeoSetBounds    = r1bsp.get_lump<titanfall::Bounds>  (titanfall::CM_GEO_SET_BOUNDS);
+    auto r1Contents        = r1bsp.get_lump<uint32_t>           (titanfall::CM_UNIQUE_CONTENTS);
+    auto r1Primitives      = r1bsp.get_lump<uint32_t>           (titanfall::CM_PRIMITIVES);
+    auto r1PrimitiveBounds = r1bsp.get_lump<titanfall::Bounds>  (titanfall::CM_PRIMITIVE_BOUNDS);
+    uint32_t numBspModels  = static_cast<uint32_t>(r1bsp.get_lump<titanfall::Model>(titanfall::MODELS).size());
+
+    // NOTE: every count & index below comes from the file, check them before following any
+    auto fail = [](const std::string &reason) { throw std::runtime_error("Invalid CM_GRID: " + reason); };
+    if (r1GridLump.empty()) { fail("no Grid"); }
+    auto r1Grid = r1GridLump[0];
+    if (r1Grid.num_cells[0] < 0 || r1Grid.num_cells[1] < 0
+     || static_cast<uint64_t>(r1Grid.num_cells[0]) * static_cast<uint64_t>(r1Grid.num_cells[1]) + numBspModels > r1GridCells.size()) {
+        fail("fewer GridCells than Grid.num_cells & bsp Models need");
+    }
+    for (int axis = 0; axis < 2; axis++) {
+        if (static_cast<int64_t>(r1Grid.cell_offset[axis]) + r1Grid.num_cells[axis] > INT32_MAX) {
+            fail("Grid.cell_offset + num_cells overflows");
+        }
+    }
+    for (const titanfall::GridCell &cell : r1GridCells) {
+        if (static_cast<size_t>(cell.first_geo_set) + cell.num_geo_sets > std::min(r1GeoSets.size(), r1GeoSetBounds.size())) {
+            fail("GridCell GeoSets out of range");
+        }
+    }
+    if (r1PrimitiveBounds.size() < r1Primitives.size()) { fail("fewer PrimitiveBounds than Primitives"); }
+
+    // copy base data (we will add to these vectors later)
+    for (size_t i = 0; i < r1Primitives.size(); i++) {
+        r2Primitives.push_back(r1Primitives[i]);
+        r2PrimitiveBounds.push_back(r1PrimitiveBounds[i]);
+    }
+
+    for (size_t i = 0; i < r1Contents.size(); i++) {
+        r2Contents.push_back(r1Contents[i]);
+    }
+
+    r2Grid = r1Grid;  // will update num_straddle_groups later
+
+    // validated once in convert, shared w/ the GAME_LUMP writer
+    uint32_t num_models = static_cast<uint32_t>(gameLump.model_names_.size());
+    auto &modelDict = gameLump.model_names_;
+    uint32_t num_props = static_cast<uint32_t>(gameLump.props_.size());
+    auto &props = gameLump.props_;
+
+    // base model bounds & contents flags
+    std::pmr::vector<mstudiopertrihdr_t>     modelBoundingBoxes(arena);
+    std::pmr::vector<std::vector<LocalBox>>  modelFootprints(arena);  // per-tri AABB tree nodes
+    std::pmr::vector<uint32_t>               modelContents(arena);
+    for (uint32_t i = 0; i < num_models; i++) {
+        checkCancelled(options.context, "addPropsToCmGrid");
+        std::string path = modelPath(options, modelDict[i]);
+        if (options.model_cache != nullptr) {
+            ModelMetadata metadata = options.model_cache->get(path, options.footprint_depth);
+            modelBoundingBoxes.push_back(metadata.per_tri);
+            modelFootprints.push_back(std::move(metadata.footprint));
+            modelContents.push_back(metadata.contents);
+            continue;
+        }
+        Model model {path.c_str()};
+        mstudiopertrihdr_t *perTri = model.getPerTriHeader();
+        if (perTri == 0) {
+            throw std::runtime_error("Model has no per-tri AABB header: " + path);
+        }
+        modelBoundingBoxes.push_back(*perTri);
+        modelFootprints.push_back(model.getFootprint(options.footprint_depth));
+        modelContents.push_back(model.getContents());
+    }
+
+
+    struct PropData {
+        uint32_t           index;  // index in GAME_LUMP.sprp.props
+        MinMax             bounds;  // world AABB; only used for GridCell footprint
+        titanfall::Bounds  oriented_bounds;  // Primitive bounds
+        uint32_t           collision_flags;
+        int                unique_contents;  // index into UniqueContents
+        uint32_t           first_box, num_boxes;  // world space footprint, in propBoxes
+    };
+    // can be turned into Primitive + Bounds or GeoSet + Bounds
+    // NOTE: we can't use bitfields for primitives, since order varies depending on compiler
+    // titanfall::Primitive p {.type=96, .index=index, .unique_contents=unique_contents};
+    // titanfall::GeoSet gs {.straddle_group=..., .num_primitives=1, .primitive={^^^}};
+    // for GeoSets w/ multiple props: {.num_primitives=..., .primitive={.type=0, .index=first_primitive}};
+
+    // collect metadata for each collidable prop
+    std::pmr::vector<PropData> collidable(arena);
+    std::pmr::vector<MinMax> propBoxes(arena);
+    QuantisationReport &quantisationReport = report.quantisation;
+    PropTransformCache transforms(arena);
+    for (uint32_t i = 0; i < num_props; i++) {
+        if ((i & 0xFF) == 0) {
+            checkCancelled(options.context, "addPropsToCmGrid");
+            reportProgress(options.context, "addPropsToCmGrid", 0.5f * i / num_props);
+        }
+        if (props[i].solid_type == 0) {
+            continue;  // prop isn't collidable, skip it
+        }
+
+        // bounding box
+        __m128 origin = _mm_set_ps(0, props[i].origin.z, props[i].origin.y, props[i].origin.x);
+        const PropTransform &transform = transforms.get(props[i].model_name, props[i].angles, props[i].scale,
+            modelBoundingBoxes[props[i].model_name], modelFootprints[props[i].model_name]);
+        MinMax bounds = translate(transform.bounds, origin);
+        uint32_t firstBox = static_cast<uint32_t>(propBoxes.size());
+        for (const MinMax &box : transforms.footprint(transform)) {
+            propBoxes.push_back(translate(box, origin));
+        }
+        titanfall::Bounds orientedBounds;
+        if (transform.yaw_only) {
+            orientedBounds = bounds_from_yaw(transform.yaw, props[i].origin, quantisationReport);
+        } else {
+            orientedBounds = bounds_from_minmax(bounds);
+            quantisationReport.num_axis_aligned++;
+        }
+
+        // collision flags
+        uint32_t collisionFlags = modelContents[props[i].model_name];
+        if ((collisionFlags & 1) != 0 || !collisionFlags) {
+            collisionFlags = (collisionFlags & 0xFFFFFFFE) | 0xEB0280;
+        }
+        if ((collisionFlags & 2) != 0) {
+            collisionFlags = (collisionFlags & 0xFFF7FFFD) | 0xE30240;
+        }
+        if ((collisionFlags & 8) != 0) {
+            collisionFlags = (collisionFlags & 0xFFB7FFF7) | 0xA30240;
+        }
+        collisionFlags &= ~props[i].collision_flags_remove;
+
+        // uniqueContentsIndex
+        int uniqueContentsIndex = 0;
+        for (uint32_t uniqueContents : r2Contents) {
+            if (uniqueContents == collisionFlags) {
+                break;
+            }
+            uniqueContentsIndex++;
+        }
+        if (uniqueContentsIndex == r2Contents.size()) {
+            r2Contents.push_back(collisionFlags);  // NOTE: limits are checked once every GeoSet is built
+        }
+
+        collidable.push_back({
+            .index           = i,
+            .bounds          = bounds,
+            .oriented_bounds = orientedBounds,
+            .collision_flags = collisionFlags,
+            .unique_contents = uniqueContentsIndex,
+            .first_box       = firstBox,
+            .num_boxes       = static_cast<uint32_t>(propBoxes.size()) - firstBox});
+    }
+
+    report.transform_cache_hits   = transforms.hits_;
+    report.transform_cache_misses = transforms.misses_;
+
+    // calls test w/ each GridCell of layout that [mins, maxs] (xy) could overlap, row by row
+    // -- a cell of slack either side; test decides
+    auto nearbyCells = [](const titanfall::Grid &layout, const float *mins, const float *maxs, auto &&test) {
+        int first[2], last[2];
+        for (int axis = 0; axis < 2; axis++) {
+            grid_tuning::cellRange(layout, axis, mins[axis], maxs[axis], first[axis], last[axis]);
+        }
+        float gridCellMins[2], gridCellMaxs[2];  // x & ys
+        for (int y = first[1]; y <= last[1]; y++) {
+            gridCellMins[1] = (y + layout.cell_offset[1]) * layout.scale;
+            gridCellMaxs[1] = gridCellMins[1] + layout.scale;
+            for (int x = first[0]; x <= last[0]; x++) {
+                gridCellMins[0] = (x + layout.cell_offset[0]) * layout.scale;
+                gridCellMaxs[0] = gridCellMins[0] + layout.scale;
+                test(gridCellMins, gridCellMaxs, y * layout.num_cells[0] + x);
+            }
+        }
+    };
+    // NOTE: only cells testCollision accepts, so the range is taken from the same corners it uses
+    auto touchedCells = [&](const titanfall::Grid &layout, const MinMax &bounds, auto &&test) {
+        float mins[2], maxs[2];
+        collision_xy(bounds.min, mins[0], mins[1]);
+        collision_xy(bounds.max, maxs[0], maxs[1]);
+        nearbyCells(layout, mins, maxs, [&](float *cellMins, float *cellMaxs, int gridCellIndex) {
+            if (testCollision(cellMins, cellMaxs, bounds.min, bounds.max)) { test(cellMins, cellMaxs, gridCellIndex); }
+        });
+    };
+    // brush & tricoll GeoSets, w/ the same 1 unit of slack as testCollision
+    auto brushCells = [&](const titanfall::Grid &layout, const MinMax &box, auto &&test) {
+        alignas(16) float mins[4], maxs[4];
+        _mm_store_ps(mins, box.min);
+        _mm_store_ps(maxs, box.max);
+        nearbyCells(layout, mins, maxs, [&](float *cellMins, float *cellMaxs, int gridCellIndex) {
+            if (cellMins[0] - 1 <= maxs[0] && cellMaxs[0] + 1 >= mins[0] && cellMins[1] - 1 <= maxs[1] && cellMaxs[1] + 1 >= mins[1]) {
+                test(gridCellIndex);
+            }
+        });
+    };
+
+    // sort props into straddle groups, by the set of GridCells each touches in layout
+    uint32_t &cellsTouchedByBounds    = report.cells_touched_by_bounds;
+    uint32_t &cellsTouchedByFootprint = report.cells_touched_by_footprint;
+    typedef std::pmr::map<std::pmr::set<int>, std::pmr::vector<PropData>> StraddleGroups;
+    auto groupProps = [&](const titanfall::Grid &layout, StraddleGroups &groups, bool count) {
+        uint32_t grouped = 0;
+        for (const PropData &prop : collidable) {
+            if ((grouped++ & 0xFF) == 0) { checkCancelled(options.context, "addPropsToCmGrid"); }
+            std::pmr::set<int> gridCellsTouched(arena);
+            touchedCells(layout, prop.bounds, [&](float *cellMins, float *cellMaxs, int gridCellIndex) {
+                cellsTouchedByBounds += count;
+                // drop cells the model's geometry never reaches
+                for (uint32_t j = 0; j < prop.num_boxes; j++) {
+                    const MinMax &child = propBoxes[prop.first_box + j];
+                    if (testCollision(cellMins, cellMaxs, child.min, child.max)) {
+                        gridCellsTouched.insert(gridCellIndex);
+                        cellsTouchedByFootprint += count && options.footprint_depth > 0;
+                        break;
+                    }
+                }
+            });
+            groups[std::move(gridCellsTouched)].push_back(prop);
+        }
+    };
+
+    // worldspawn layout: r1's, unless re-tuned
+    int numR1WorldspawnGridCells = r1Grid.num_cells[0] * r1Grid.num_cells[1];
+    titanfall::Grid layout = r1Grid;
+    struct BrushGeoSet {
+        titanfall::GeoSet  geo_set;
+        titanfall::Bounds  bounds;
+        MinMax             box;  // world AABB of bounds
+    };
+    std::pmr::vector<BrushGeoSet> brushGeoSets(arena);  // r1 worldspawn GeoSets, each once; only if re-tuned
+    if (options.cm_grid_scale != 0) {
+        // a GeoSet in more than 1 r1 cell shares a straddle group w/ its copies
+        std::pmr::set<std::tuple<uint16_t, uint16_t, uint32_t>> seen(arena);
+        uint32_t numUnique = 0;
+        for (int i = 0; i < numR1WorldspawnGridCells; i++) {
+            for (uint32_t j = 0; j < r1GridCells[i].num_geo_sets; j++) {
+                const titanfall::GeoSet &geo_set = r1GeoSets[r1GridCells[i].first_geo_set + j];
+                if (geo_set.straddle_group != 0
+                 && !seen.insert({geo_set.straddle_group, geo_set.num_primitives, geo_set.primitive}).second) {
+                    continue;
+                }
+                const titanfall::Bounds &bounds = r1GeoSetBounds[r1GridCells[i].first_geo_set + j];
+                brushGeoSets.push_back({geo_set, bounds, minmax_from_bounds(bounds)});
+                numUnique++;
+            }
+        }
+
+        // GeoSets per cell of a layout, w/ props grouped as they would be
+        auto evaluate = [&](const titanfall::Grid &candidate, bool original) {
+            std::vector<uint32_t> perCell(static_cast<size_t>(candidate.num_cells[0]) * candidate.num_cells[1], 0);
+            uint32_t unique = numUnique;
+            for (int i = 0; original && i < numR1WorldspawnGridCells; i++) {
+                perCell[i] = r1GridCells[i].num_geo_sets;
+            }
+            for (const BrushGeoSet &brush : brushGeoSets) {
+                if (original) { break; }
+                brushCells(candidate, brush.box, [&](int cell) { perCell[cell]++; });
+            }
+            StraddleGroups groups(arena);
+            groupProps(candidate, groups, false);
+            for (auto &[cells_set, _] : groups) {
+                unique++;
+                for (int cell : cells_set) { perCell[cell]++; }
+            }
+            return grid_tuning::stats(candidate, perCell, unique);
+        };
+
+        grid_tuning::Report &tuning = report.grid_tuning;
+        tuning.original = evaluate(r1Grid, true);
+        tuning.tuned = tuning.original;
+        std::vector<float> scales = options.cm_grid_scale == grid_tuning::AUTO
+            ? grid_tuning::candidates(r1Grid) : std::vector<float>{options.cm_grid_scale};
+        for (float scale : scales) {
+            titanfall::Grid candidate = grid_tuning::layout(r1Grid, scale);
+            tuning.num_candidates++;
+            if (candidate.scale == r1Grid.scale && candidate.num_cells[0] == r1Grid.num_cells[0]
+             && candidate.num_cells[1] == r1Grid.num_cells[1]) {
+                continue;  // that's the original
+            }
+            grid_tuning::Stats stats = evaluate(candidate, false);
+            bool fits = stats.geo_sets <= CapacityReport::MAX_GEO_SETS;
+            // a chosen scale is always used; the limits are checked once the GeoSets are built
+            if (options.cm_grid_scale != grid_tuning::AUTO || (fits && stats.cost() < tuning.tuned.cost())) {
+                tuning.tuned = stats;
+                layout = candidate;
+            }
+        }
+        tuning.retuned = true;
+    }
+    // NOTE: if the original layout won, r1's cells are kept exactly as they were
+    bool rebucketed = layout.scale != r1Grid.scale || layout.num_cells[0] != r1Grid.num_cells[0]
+                   || layout.num_cells[1] != r1Grid.num_cells[1];
+    r2Grid.scale = layout.scale;
+    r2Grid.cell_offset[0] = layout.cell_offset[0];
+    r2Grid.cell_offset[1] = layout.cell_offset[1];
+    r2Grid.num_cells[0] = layout.num_cells[0];
+    r2Grid.num_cells[1] = layout.num_cells[1];
+
+    StraddleGroups straddleGroupProps(arena);
+    groupProps(layout, straddleGroupProps, true);
+    reportProgress(options.context, "addPropsToCmGrid", 0.75f);
+
+    // TODO: seperate list for oversize props
+    // -- extents.x >= 2048 on either X or Y axis seems reasonable
+    // -- all go into a single GeoSet
+    // -- that GeoSet will be indexed by the Worldspawn GridCell
+
+    // assemble straddle groups
+    CapacityReport &capacity = report.capacity;
+    std::pmr::vector<std::pair<titanfall::GeoSet, titanfall::Bounds>>  propGeoSets(arena);
+    std::pmr::map<int, std::pmr::set<int>>  cellStraddleGroups(arena);
+    // ^ {cell_index: {geo_set_index}}
+    int32_t group_id = r1Grid.num_straddle_groups;
+    std::pmr::vector<StraddleGroups::value_type*> emitOrder(arena);
+    for (auto &group : straddleGroupProps) { emitOrder.push_back(&group); }
+    if (options.morton_order) {
+        // props near each other in space sit near each other in CM_PRIMITIVES, CM_GEO_SETS & their Bounds
+        std::pmr::vector<std::pair<uint64_t, StraddleGroups::value_type*>> codes(arena);
+        for (auto *group : emitOrder) {
+            std::pmr::vector<PropData> &props_data = group->second;
+            std::stable_sort(props_data.begin(), props_data.end(), [](const PropData &a, const PropData &b) {
+                return morton_code(a.oriented_bounds) < morton_code(b.oriented_bounds);
+            });
+            MinMax groupBounds;
+            for (const PropData &prop_data : props_data) {
+                groupBounds.addVector(prop_data.bounds.min);
+                groupBounds.addVector(prop_data.bounds.max);
+            }
+            codes.push_back({morton_code(bounds_from_minmax(groupBounds)), group});
+        }
+        std::stable_sort(codes.begin(), codes.end(), [](auto &a, auto &b) { return a.first < b.first; });
+        for (size_t i = 0; i < codes.size(); i++) { emitOrder[i] = codes[i].second; }
+    }
+    for (auto *group : emitOrder) {
+        if ((propGeoSets.size() & 0xFF) == 0) { checkCancelled(options.context, "addPropsToCmGrid"); }
+        auto &[cells_set, props_data] = *group;
+        titanfall::GeoSet  geo_set;
+        titanfall::Bounds  bounds;
+        // straddle group
+        if (cells_set.size() == 1) {
+            geo_set.straddle_group = 0;
+        } else {
+            geo_set.straddle_group = static_cast<uint16_t>(group_id);
+            group_id++;
+        }
+        // primitive(s)
+        if (props_data.size() == 1) {
+            geo_set.num_primitives = 1;
+            const PropData  &prop_data = props_data[0];
+            geo_set.primitive = (0x60 << 24) | (prop_data.index << 8) | (prop_data.unique_contents);
+            capacity.max_prop_index = std::max(capacity.max_prop_index, prop_data.index);
+            // bounds
+            bounds = prop_data.oriented_bounds;
+        } else {
+            geo_set.num_primitives = static_cast<uint16_t>(props_data.size());
+            uint16_t  index = static_cast<uint16_t>(r2Primitives.size());
+            capacity.max_first_primitive = std::max(capacity.max_first_primitive, static_cast<uint32_t>(r2Primitives.size()));
+            uint32_t  collision_flags = 0x00000000;
+            // bounds
+            MinMax  geoSetBounds;
+            for (const PropData &prop_data : props_data) {
+                // per-prop primitive & bounds
+                uint32_t  prop_primitive = (0x60 << 24) | (prop_data.index << 8) | (prop_data.unique_contents);
+                capacity.max_prop_index = std::max(capacity.max_prop_index, prop_data.index);
+                r2Primitives.push_back(prop_primitive);
+                r2PrimitiveBounds.push_back(prop_data.oriented_bounds);
+                // expand bounds
+                geoSetBounds.addVector(prop_data.bounds.min);
+                geoSetBounds.addVector(prop_data.bounds.max);
+                // combine contents_flags
+                collision_flags |= prop_data.collision_flags;
+            }
+            // get unique_contents_index of GeoSet
+            int unique_contents_index = 0;
+            for (uint32_t unique_contents : r2Contents) {
+                if (unique_contents == collision_flags) {
+                    break;
+                }
+                unique_contents_index++;
+            }
+            if (unique_contents_index == r2Contents.size()) {
+                r2Contents.push_back(collision_flags);
+            }
+            // index child Primitives & UniqueContents
+            // NOTE: type is always 0 when num_primitives == 1
+            geo_set.primitive = (index << 8) | (unique_contents_index);
+            bounds = bounds_from_minmax(geoSetBounds);
+        }
+
+        // link GeoSet to GridCell(s)
+        for (int cell_index : cells_set) {
+            cellStraddleGroups[cell_index].insert(static_cast<int>(propGeoSets.size()));
+        }
+        propGeoSets.push_back({geo_set, bounds});
+    }
+
+    // re-bucket r1's worldspawn GeoSets; any that now straddle cells get a straddle group, if they didn't have one
+    int numWorldspawnGridCells = layout.num_cells[0] * layout.num_cells[1];
+    std::pmr::vector<std::pmr::vector<uint32_t>> cellBrushGeoSets(arena);  // {cell_index: [brushGeoSets index]}
+    if (rebucketed) {
+        cellBrushGeoSets.resize(numWorldspawnGridCells);
+        for (uint32_t i = 0; i < brushGeoSets.size(); i++) {
+            uint32_t numCells = 0;
+            brushCells(layout, brushGeoSets[i].box, [&](int cell) {
+                cellBrushGeoSets[cell].push_back(i);
+                numCells++;
+            });
+            if (numCells > 1 && brushGeoSets[i].geo_set.straddle_group == 0) {
+                brushGeoSets[i].geo_set.straddle_group = static_cast<uint16_t>(group_id);
+                group_id++;
+            }
+        }
+    }
+
+    // update Grid.num_straddle_groups
+    r2Grid.num_straddle_groups = group_id;
+
+    // add props to worldspawn GridCells
+    for (int i = 0; i < numWorldspawnGridCells; i++) {
+        titanfall::GridCell  r2GridCell;
+
+        // copy GeoSets from r1
+        r2GridCell.first_geo_set = static_cast<uint16_t>(r2GeoSets.size());
+        if (rebucketed) {
+            r2GridCell.num_geo_sets = static_cast<uint16_t>(cellBrushGeoSets[i].size());
+            for (uint32_t brush : cellBrushGeoSets[i]) {
+                r2GeoSets.push_back(brushGeoSets[brush].geo_set);
+                r2GeoSetBounds.push_back(brushGeoSets[brush].bounds);
+            }
+        } else {
+            titanfall::GridCell  r1GridCell = r1GridCells[i];
+            r2GridCell.num_geo_sets  = r1GridCell.num_geo_sets;
+            for (uint32_t j = 0; j < r1GridCell.num_geo_sets; j++) {
+                r2GeoSets.push_back(r1GeoSets[r1GridCell.first_geo_set + j]);
+                r2GeoSetBounds.push_back(r1GeoSetBounds[r1GridCell.first_geo_set + j]);
+            }
+        }
+
+        // TODO: optimisation:
+        // if (r1Cell.num_geo_sets == 0) {
+        //     r2Cell.num_geo_sets  = static_cast<uint16_t>(cellStraddleGroups[i].size());
+        //     r2Cell.first_geo_set = ...;  // index previous appearance of cellStraddleGroups[i]
+        // }
+
+        // append prop GeoSets
+        auto cellGeoSets = cellStraddleGroups.find(i);
+        if (cellGeoSets != cellStraddleGroups.end()) {
+            r2GridCell.num_geo_sets += static_cast<uint16_t>(cellGeoSets->second.size());
+            for (auto geo_set_index : cellGeoSets->second) {
+                const auto &[geo_set, bounds] = propGeoSets[geo_set_index];
+                r2GeoSets.push_back(geo_set);
+                r2GeoSetBounds.push_back(bounds);
+            }
+        }
+        r2GridCells.push_back(r2GridCell);
+    }
+
+    // copy GeoSets for each bsp Model
+    for (uint32_t i = 0; i < numBspModels; i++) {
+        titanfall::GridCell r1GridCell = r1GridCells[numR1WorldspawnGridCells + i];
+        titanfall::GridCell r2GridCell;
+
+        // copy GeoSets from r1
+        r2GridCell.first_geo_set = static_cast<uint16_t>(r2GeoSets.size());
+        r2GridCell.num_geo_sets  = r1GridCell.num_geo_sets;
+        for (uint32_t j = 0; j < r1GridCell.num_geo_sets; j++) {
+            r2GeoSets.push_back(r1GeoSets[r1GridCell.first_geo_set + j]);
+            r2GeoSetBounds.push_back(r1GeoSetBounds[r1GridCell.first_geo_set + j]);
+        }
+        r2GridCells.push_back(r2GridCell);
+    }
+
+    // check index limits
+    capacity.unique_contents    = static_cast<uint32_t>(r2Contents.size());
+    capacity.geo_sets           = static_cast<uint32_t>(r2GeoSets.size());
+    capacity.r1_straddle_groups = static_cast<uint32_t>(r1Grid.num_straddle_groups);
+    capacity.straddle_groups    = static_cast<uint32_t>(group_id);
+    std::string exceeded = capacity.exceeded();
+    if (enforce_limits && !exceeded.empty()) {
+        throw std::runtime_error(exceeded);
+    }
+    reportProgress(options.context, "addPropsToCmGrid", 1.0f);
+}
+
+
+void convertTricoll(
+    Bsp                                   &r1bsp,
+    std::vector<titanfall::TricollHeader> &r2Header,
+    std::vector<uint16_t>                 &r2BevelStarts,
+    std::vector<uint32_t>                 &r2BevelIndices,
+    std::pmr::memory_resource             *arena,
+    ConversionContext                     *context = nullptr) {
+
+    auto r1TricollHeader = r1bsp.get_lump<titanfall::TricollHeader>(titanfall::TRICOLL_HEADER);
+    auto r1Indices       = r1bsp.get_lump<uint32_t>(titanfall::TRICOLL_BEVEL_INDICES);
+    auto r1Starts        = r1bsp.get_lump<uint16_t>(titanfall::TRICOLL_BEVEL_STARTS);
+    auto r1Tris          = r1bsp.get_lump<uint32_t>(titanfall::TRICOLL_TRIS);
+    int headerCount = r1bsp.get_lump_length(titanfall::TRICOLL_HEADER) / sizeof(titanfall::TricollHeader);
+
+    std::pmr::vector<uint32_t> writeBuffer(arena);  // reused for each header
+    for (int i = 0; i < headerCount; i++) {
+        if ((i & 0xFF) == 0) {
+            checkCancelled(context, "convertTricoll");
+            reportProgress(context, "convertTricoll", static_cast<float>(i) / headerCount);
+        }
+        titanfall::TricollHeader header = r1TricollHeader[i];
+        uint32_t num_bevel_indices = header.num_bevel_indices;
+        uint32_t first_bevel_index = header.first_bevel_index;
+        header.first_bevel_index = (uint32_t)r2BevelIndices.size();
+        r2Header.push_back(header);
+        if (!num_bevel_indices) {
+            continue;
+        }
+        auto fail = [i](const char *reason) {
+            throw std::runtime_error("Invalid TricollHeader " + std::to_string(i) + ": " + reason);
+        };
+        if (header.first_triangle > r1Tris.size() || header.num_triangles > r1Tris.size() - header.first_triangle
+         || header.first_triangle + header.num_triangles > r1Starts.size()) {
+            fail("triangles are outside the lump");
+        }
+        if (first_bevel_index > r1Indices.size()) {
+            fail("first_bevel_index is outside the lump");
+        }
+
+        // NOTE: 1 extra word, since write11Bit always touches 2 words
+        writeBuffer.assign(((num_bevel_indices * 11) + 31) / 32 + 1, 0);
+        auto write = [&](uint16_t writePtr, uint32_t data) {
+            if (writePtr >= num_bevel_indices) { fail("bevels run past num_bevel_indices"); }
+            write11Bit(writeBuffer.data(), writePtr * 11, data);
+        };
+
+        uint16_t *r1LocalStarts = &r1Starts[header.first_triangle];
+        uint32_t *r1LocalTris = &r1Tris[header.first_triangle];
+        uint32_t readIndices = 0;
+        std::pmr::map<uint16_t, uint16_t> starts(arena);
+        for (int k = 0; k < header.num_triangles; k++) {
+            uint16_t num_bevels = (r1LocalTris[k] >> 24) & 0xF;
+            uint16_t start = r1LocalStarts[k];
+            if (starts.contains(start)) {
+                starts[start] = starts[start] > num_bevels ? starts[start] : num_bevels;
+            } else {
+                starts.emplace(start, num_bevels);
+            }
+        }
+        for (auto &pair : starts) {
+            uint16_t start = pair.first;
+            uint16_t num_bevels = pair.second;
+            BitReader read {r1Indices.data() + first_bevel_index, r1Indices.data() + r1Indices.size(), (uint64_t)(10 * start)};
+            uint16_t writePtr = start;
+            if (num_bevels == 15) {
+                uint32_t index;
+                do {
+                    uint32_t data = read.Read10();
+                    data |= (read.Read10() << 10);
+                    write(writePtr++, data & 0x7FF);
+                    write(writePtr++, data >> 11);
+                    num_bevels = data & 0x7F;
+                    index = data >> 7;
+                    if (index >= r1TricollHeader.size()) {
+                        fprintf(stderr, "Error Tricoll out of range\n");
+                    }
+                    for (uint32_t j = 0; j < num_bevels; j++) {
+                        uint32_t val = read.Read10();
+                        write(writePtr++, val);
+                        readIndices++;
+                    }
+                } while ((index != i) && num_bevels);
+            } else {
+                for (uint32_t j = 0; j < num_bevels; j++) {
+                    uint32_t val = read.Read10();;
+                    write(writePtr++, val);
+                }
+            }
+        }
+        r2BevelIndices.insert(r2BevelIndices.end(), writeBuffer.begin(), writeBuffer.end() - 1);
+    }
+    reportProgress(context, "convertTricoll", 1.0f);
+}
+
+
+// r1 lumps, sorted by offset
+struct SortKey { int offset, index; };
+
+
+// <out>.hashes: the file digest, then 1 line per lump in file order
+void write_hashes(const std::string &filename, const char *out_filename, ConversionReport &report, std::vector<SortKey> &lumpOrder) {
+    FILE *file = fopen(filename.c_str(), "w");
+    if (file == nullptr) {
+        throw std::runtime_error("Could not open file for writing: '" + filename + "'");
+    }
+    char hex[17];
+    hash::to_hex(report.file_hash, hex);
+    fprintf(file, "file %s %s\n", hex, out_filename);
+    for (SortKey &lump : lumpOrder) {
+        hash::to_hex(report.lump_hashes[lump.index], hex);
+        fprintf(file, "lump 0x%02X %s %s\n", lump.index, hex, lumps::DESCRIPTORS[lump.index].name);
+    }
+    fclose(file);
+}
+
+
+// the options that change the output bytes, for OutputCache::key
+uint64_t outputSettings(const ConvertOptions &options) {
+    uint64_t settings = hash::hash64(&options.external_threshold, sizeof(options.external_threshold));
+    settings = hash::hash64(&options.cm_grid_scale, sizeof(options.cm_grid_scale), settings);
+    settings = options.morton_order ? hash::hash64(&options.morton_order, sizeof(options.morton_order), settings) : settings;
+    settings = options.footprint_depth ? hash::hash64(&options.footprint_depth, sizeof(options.footprint_depth), settings) : settings;
+    for (int i = 0; i < 128; i++) {
+        settings = options.external_lumps[i] ? hash::hash64(&i, sizeof(i), settings) : settings;
+    }
+    return settings;
+}
+
+
+// a lump as written, wherever it was written to
+template <typename T>
+std::span<const T> writtenLump(BspHeader &header, std::array<char*, 128> &lumpData, int index) {
+    return {reinterpret_cast<const T*>(lumpData[index]), header.lumps[index].length / sizeof(T)};
+}
+
+
+// NOTE: the engine loads <map>.bsp.<index>.bsp_lump in place of the lump in the .bsp, if it exists
+// -- the LumpHeader keeps the length & version, w/ an offset of 0
+std::string externalLumpFilename(const char *out_filename, int index) {
+    char suffix[32];
+    snprintf(suffix, 32, ".%04x.bsp_lump", index);
+    return out_filename + std::string(suffix);
+}
+
+
+// renames a freshly written file over path, unless path already holds the same bytes
+// -- so unchanged lumps keep their inode (& any hardlinks to them) across builds
+void replaceIfChanged(const std::string &written, const std::string &path) {
+    std::error_code error;
+    if (std::filesystem::file_size(path, error) == std::filesystem::file_size(written) && !error) {
+        memory_mapped_file a, b;
+        a.open_existing(written.c_str());
+        b.open_existing(path.c_str());
+        if (a.data() == b.data()) {
+            a.close();
+            b.close();
+            std::filesystem::remove(written);
+            return;
+        }
+    }
+    std::filesystem::rename(written, path);
+}
+
+
+// ConvertOptions::output_fd: every lump is generated & sized first, so the header can be sent before any lump
+// -- lumps then follow strictly in file order; copied & generated lumps are sent from where they already are,
+//    others are converted into 1 buffer, reused (so at most the largest converted lump is buffered)
+// NOTE: a cancelled stream can't be taken back, the reader sees it end early
+int streamConvert(Bsp &r1bsp, const char *out_filename, ConvertOptions &options) {
+    if (options.cache_dir != nullptr || options.external_lumps.any() || options.external_threshold != 0
+     || options.verify || options.output_memory != nullptr) {
+        throw std::invalid_argument("Streamed conversions can't use the output cache, external lumps, verify or memory output");
+    }
+    lumps::validate(r1bsp);
+    GameLumpView<titanfall::StaticProp> gameLump(r1bsp);
+
+    lumps::GeneratedLumps generated;
+    ConversionReport report;
+    report.io = IoBackend::STREAM;
+    report.measured = options.perf_counters;
+    perf_counters::Report *perf = options.perf_counters ? &report.perf : nullptr;
+    lumps::Sources sources = {r1bsp, gameLump, generated};
+
+    TaskGraph graph;
+    graph.add("convertTricoll", [&]() {
+        alloc_stats::Scope allocations("convertTricoll");
+        perf_counters::Scope counters("convertTricoll", perf);
+        std::pmr::monotonic_buffer_resource arena;
+        convertTricoll(r1bsp, generated.tricoll_headers, generated.bevel_starts, generated.bevel_indices, &arena, options.context);
+    });
+    graph.add("addPropsToCmGrid", [&]() {
+        alloc_stats::Scope allocations("addPropsToCmGrid");
+        perf_counters::Scope counters("addPropsToCmGrid", perf);
+        std::pmr::monotonic_buffer_resource arena;
+        addPropsToCmGrid(r1bsp, gameLump, generated.grid, generated.grid_cells, generated.geo_sets, generated.geo_set_bounds,
+            generated.primitives, generated.primitive_bounds, generated.unique_contents,
+            options, report, &arena);
+    });
+    graph.run(options.num_threads);
+
+    // plan: the same layout as convert, r1 order & each lump 4 byte aligned
+    BspHeader header = {
+        .magic    = MAGIC_rBSP,
+        .version  = titanfall2::VERSION,
+        .revision = r1bsp.header_->revision,
+        ._127     = 127
+    };
+    std::vector<SortKey> lumpOrder;
+    for (int i = 0; i < 128; i++) {
+        int offset = static_cast<int>(r1bsp.header_->lumps[i].offset);
+        if (offset != 0) { lumpOrder.push_back({offset, i}); }
+    }
+    std::sort(lumpOrder.begin(), lumpOrder.end(), [](auto a, auto b) { return a.offset < b.offset; });
+    size_t end = sizeof(header);
+    for (SortKey &lump : lumpOrder) {
+        LumpHeader &r1lump = r1bsp.header_->lumps[lump.index];
+        uint32_t length = lumps::LENGTHS[lump.index](sources);
+        end = (end + 3) & ~3;
+        header.lumps[lump.index] = {
+            .offset  = static_cast<uint32_t>(end),
+            .length  = length,
+            .version = lumps::r2_version(lump.index, r1lump),
+            .fourCC  = r1lump.fourCC
+        };
+        end += length;
+    }
+
+    OutputStream stream(options.output_fd);
+    {
+        perf_counters::Scope counters("streamLumps", perf);
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        std::vector<char> buffer;
+        for (size_t i = 0; i < lumpOrder.size(); i++) {
+            checkCancelled(options.context, "streamLumps");
+            int index = lumpOrder[i].index;
+            LumpHeader &r2lump = header.lumps[index];
+            std::span<const char> bytes;
+            if (!lumps::VIEWS[index](sources, bytes)) {
+                buffer.resize(r2lump.length);
+                lumps::WRITERS[index](sources, buffer.data(), r2lump.offset);
+                bytes = {buffer.data(), buffer.size()};
+            }
+            report.lump_hashes[index] = hash::hash64(bytes.data(), bytes.size());
+            stream.pad(r2lump.offset);
+            stream.write(bytes.data(), bytes.size());
+            reportProgress(options.context, "streamLumps", static_cast<float>(i + 1) / lumpOrder.size());
+        }
+    }
+
+    report.file_hash = hash::hash64(&header, sizeof(header));
+    for (SortKey &lump : lumpOrder) {
+        report.file_hash = hash::hash64(&report.lump_hashes[lump.index], sizeof(uint64_t), report.file_hash);
+    }
+    if (options.write_hashes && out_filename != nullptr) {
+        write_hashes(std::string(out_filename) + ".hashes", out_filename, report, lumpOrder);
+    }
+    if (options.print_report) { report.print(options.output_fd == fileno(stdout) ? stderr : stdout); }
+    return 0;
+}
+
+
+// in_name is only for messages; the map may not have come from a file
+int convert(Bsp &r1bsp, const char *in_name, const char *out_filename, ConvertOptions &options) {
+    alloc_stats::enabled = options.alloc_stats;
+    alloc_stats::out = options.output_fd == fileno(stdout) ? stderr : stdout;  // stdout only carries the map
+    alloc_stats::Scope allocations("convert (calling thread)");
+    if (!r1bsp.is_valid() || r1bsp.header_->version != titanfall::VERSION) {
+        fprintf(stderr, "'%s' is not a Titanfall map!\n", in_name);
+        return 1;
+    }
+    if (options.output_fd != -1) { return streamConvert(r1bsp, out_filename, options); }
+    bool in_memory = options.output_memory != nullptr;
+    if (in_memory && (options.cache_dir != nullptr || options.external_lumps.any() || options.external_threshold != 0)) {
+        throw std::invalid_argument("In memory conversions can't use the output cache or external lumps");
+    }
+
+    // NOTE: both throw if the map is malformed, before the output file is created
+    lumps::validate(r1bsp);
+    GameLumpView<titanfall::StaticProp> gameLump(r1bsp);
+
+    std::unique_ptr<OutputCache> cache;
+    uint64_t cache_key = 0;
+    if (options.cache_dir != nullptr) {
+        cache = std::make_unique<OutputCache>(options.cache_dir, options.cache_size);
+        cache_key = OutputCache::key(r1bsp, gameLump, [&](const ModelDictEntry &entry) { return modelPath(options, entry); },
+            outputSettings(options));
+        OutputCache::Materialised method = cache->fetch(cache_key, out_filename, options.write_hashes);
+        if (method != OutputCache::Materialised::NONE) {
+            for (int i = 0; i < 128; i++) {  // stale external lumps would override the cached .bsp
+                std::string filename = externalLumpFilename(out_filename, i);
+                if (!std::filesystem::exists(cache->entry(cache_key) / ("map.bsp" + filename.substr(strlen(out_filename))))) {
+                    std::filesystem::remove(filename);
+                }
+            }
+            if (options.print_report) {
+                printf("Output cache hit: %s (%s)\n", cache->entry(cache_key).filename().string().c_str(), OutputCache::name(method));
+            }
+            return 0;
+        }
+    }
+
+    // NOTE: replace rather than overwrite, the old output may be hardlinked to an OutputCache entry
+    if (!in_memory) { remove(out_filename); }
+    const size_t reserved_size = 2 * r1bsp.file_.size();  // only the MMAP & MEMORY backends need to reserve space
+    OutputFile outfile = in_memory ? OutputFile(*options.output_memory, reserved_size)
+                                   : OutputFile(out_filename, reserved_size, options.io, options.num_threads, options.verify);
+    outfile.fill(0xAA);
+
+    const size_t HEADER_KEY = 128;  // OutputFile buffer keys: lump index, or this for the header
+    BspHeader &r2bsp_header = *outfile.buffer<BspHeader>(HEADER_KEY, 0);
+    r2bsp_header = {
+        .magic    = MAGIC_rBSP,
+        .version  = titanfall2::VERSION,
+        .revision = r1bsp.header_->revision,
+        ._127     = 127
+    };
+
+    // NOTE: we'll come back to write the new LumpHeaders later
+    std::vector<SortKey> lumpOrder;
+    for (int i = 0; i < 128; i++) {
+        int offset = static_cast<int>(r1bsp.header_->lumps[i].offset);
+        if (offset != 0) {
+            lumpOrder.push_back({ offset, i });
+        }
+    }
+    std::sort(lumpOrder.begin(), lumpOrder.end(), [](auto a, auto b) { return a.offset < b.offset; });
+
+    lumps::GeneratedLumps generated;
+    ConversionReport report;
+    report.io = outfile.backend_;
+    report.measured = options.perf_counters;
+    perf_counters::Report *perf = options.perf_counters ? &report.perf : nullptr;
+    lumps::Sources sources = {r1bsp, gameLump, generated};
+
+    auto isExternal = [&](int index) -> bool {
+        uint32_t length = lumps::LENGTHS[index](sources);
+        return length != 0 && (options.external_lumps[index] || (options.external_threshold != 0 && length >= options.external_threshold));
+    };
+
+    // lumps are written in r1 order, each one 4 byte aligned; external lumps take no space in the .bsp
+    auto internalEnd = [&](size_t sort_index) -> size_t {
+        size_t end = sizeof(r2bsp_header);
+        for (size_t i = 0; i < sort_index; i++) {
+            int index = lumpOrder[i].index;
+            if (isExternal(index)) { continue; }
+            end = ((end + 3) & ~3) + lumps::LENGTHS[index](sources);
+        }
+        return end;
+    };
+
+    // each external lump gets its own mapping & writer, renamed into place once the map is complete
+    std::array<std::unique_ptr<OutputFile>, 128> externalFiles;
+    std::array<char*, 128> lumpData = {};  // as written, for verify
+    std::array<bool, 128> external = {};  // NOTE: not a bitset, each writer sets its own element
+    std::atomic<uint32_t> lumpsWritten = 0;
+    auto writeLump = [&](size_t sort_index) {
+        checkCancelled(options.context, "writeLump");
+        int index = lumpOrder[sort_index].index;
+        LumpHeader &r1lump = r1bsp.header_->lumps[index];
+        LumpHeader &r2lump = r2bsp_header.lumps[index];
+        uint32_t length = lumps::LENGTHS[index](sources);
+        if (isExternal(index)) {
+            r2lump = {.offset = 0, .length = length, .version = lumps::r2_version(index, r1lump), .fourCC = r1lump.fourCC};
+            std::string filename = externalLumpFilename(out_filename, index) + ".tmp";
+            externalFiles[index] = std::make_unique<OutputFile>(filename.c_str(), length, options.io, 1, options.verify);
+            external[index] = true;
+            lumpData[index] = externalFiles[index]->buffer(index, 0, length);
+            lumps::WRITERS[index](sources, lumpData[index], 0);
+            report.lump_hashes[index] = hash::hash64(lumpData[index], length);
+            externalFiles[index]->write(index);
+            reportProgress(options.context, "writeLump", static_cast<float>(++lumpsWritten) / lumpOrder.size());
+            return;
+        }
+        // null padding since the end of the previous lump, written along w/ the lump
+        size_t previous_end = internalEnd(sort_index);
+        size_t write_cursor = (previous_end + 3) & ~3;
+        char *padded = outfile.buffer(index, previous_end, write_cursor - previous_end + length);
+        memset(padded, 0, write_cursor - previous_end);
+
+        r2lump = {
+            .offset  = static_cast<uint32_t>(write_cursor),
+            .length  = length,
+            .version = lumps::r2_version(index, r1lump),
+            .fourCC  = r1lump.fourCC
+        };
+        lumpData[index] = padded + (write_cursor - previous_end);
+        lumps::WRITERS[index](sources, lumpData[index], r2lump.offset);
+        // NOTE: hashed while the lump is still in cache, rather than re-reading the file later
+        report.lump_hashes[index] = hash::hash64(lumpData[index], length);
+        outfile.write(index);
+        reportProgress(options.context, "writeLump", static_cast<float>(++lumpsWritten) / lumpOrder.size());
+    };
+
+    // each lump write waits on the task generating its data
+    // -- and on every task that decides the length of an earlier lump (for its offset)
+    TaskGraph graph;
+    TaskGraph::TaskId tricollTask = graph.add("convertTricoll", [&]() {
+        alloc_stats::Scope allocations("convertTricoll");
+        perf_counters::Scope counters("convertTricoll", perf);
+        // NOTE: each stage's temporaries are freed at once when its arena goes out of scope
+        std::pmr::monotonic_buffer_resource arena;
+        convertTricoll(r1bsp, generated.tricoll_headers, generated.bevel_starts, generated.bevel_indices, &arena, options.context);
+    });
+    TaskGraph::TaskId cmGridTask = graph.add("addPropsToCmGrid", [&]() {
+        alloc_stats::Scope allocations("addPropsToCmGrid");
+        perf_counters::Scope counters("addPropsToCmGrid", perf);
+        std::pmr::monotonic_buffer_resource arena;
+        addPropsToCmGrid(r1bsp, gameLump, generated.grid, generated.grid_cells, generated.geo_sets, generated.geo_set_bounds,
+            generated.primitives, generated.primitive_bounds, generated.unique_contents,
+            options, report, &arena);
+    });
+    auto generatedBy = [&](int index) -> std::vector<TaskGraph::TaskId> {
+        switch (lumps::DESCRIPTORS[index].stage) {
+            case lumps::Stage::TRICOLL: return {tricollTask};
+            case lumps::Stage::CM_GRID: return {cmGridTask};
+            default:                    return {};
+        }
+    };
+    std::vector<TaskGraph::TaskId> lengthDependencies;  // tasks sizing lumps before this one
+    for (size_t i = 0; i < lumpOrder.size(); i++) {
+        std::vector<TaskGraph::TaskId> dependencies = lengthDependencies;
+        for (TaskGraph::TaskId task : generatedBy(lumpOrder[i].index)) {
+            if (std::find(dependencies.begin(), dependencies.end(), task) == dependencies.end()) {
+                dependencies.push_back(task);
+            }
+        }
+        graph.add("writeLump", [&writeLump, perf, i]() {
+            perf_counters::Scope counters("writeLump", perf);
+            writeLump(i);
+        }, dependencies);
+        lengthDependencies = dependencies;
+    }
+    graph.run(options.num_threads);
+
+    checkCancelled(options.context, "verify");  // the last chance, before outputs are renamed into place
+    if (options.verify) {  // against the lumps as written, not the GeneratedLumps
+        perf_counters::Scope counters("verify", perf);
+        report.tricoll = tricoll::verify(
+            r1bsp.get_lump<const titanfall::TricollHeader>(titanfall::TRICOLL_HEADER),
+            r1bsp.get_lump<const uint32_t>(titanfall::TRICOLL_BEVEL_INDICES),
+            writtenLump<titanfall::TricollHeader>(r2bsp_header, lumpData, titanfall::TRICOLL_HEADER),
+            writtenLump<uint32_t>(r2bsp_header, lumpData, titanfall::TRICOLL_BEVEL_INDICES),
+            writtenLump<uint32_t>(r2bsp_header, lumpData, titanfall::TRICOLL_TRIS),
+            writtenLump<uint16_t>(r2bsp_header, lumpData, titanfall::TRICOLL_BEVEL_STARTS));
+        report.verified = true;
+    }
+
+    size_t write_cursor = internalEnd(lumpOrder.size());
+    // header, then each lump's digest in file order; the padding between lumps is implied by the header
+    report.file_hash = hash::hash64(&r2bsp_header, sizeof(r2bsp_header));
+    for (SortKey &lump : lumpOrder) {
+        report.file_hash = hash::hash64(&report.lump_hashes[lump.index], sizeof(uint64_t), report.file_hash);
+    }
+    {  // waits for any writes still in flight
+        perf_counters::Scope counters("closeOutput", perf);
+        // & any .bsp_lump left over from an earlier conversion would override the lump in the .bsp
+        for (int i = 0; i < 128 && !in_memory; i++) {
+            std::string filename = externalLumpFilename(out_filename, i);
+            if (external[i]) {
+                externalFiles[i]->close(r2bsp_header.lumps[i].length);
+                replaceIfChanged(filename + ".tmp", filename);
+            } else {
+                std::filesystem::remove(filename);
+            }
+        }
+        outfile.write(HEADER_KEY);  // the header, now the LumpHeaders are filled in
+        outfile.close(write_cursor);
+    }
+    if (options.write_hashes && !in_memory) {
+        write_hashes(std::string(out_filename) + ".hashes", out_filename, report, lumpOrder);
+    }
+    // bad bevels are reported on every run, so those outputs are never cached
+    if (cache && report.tricoll.num_errors == 0) {
+        std::filesystem::path staging = cache->stage();
+        std::filesystem::copy_file(out_filename, staging / "map.bsp");
+        for (int i = 0; i < 128; i++) {
+            if (!external[i]) { continue; }
+            std::string filename = externalLumpFilename(out_filename, i);
+            std::filesystem::copy_file(filename, staging / ("map.bsp" + filename.substr(strlen(out_filename))));
+        }
+        write_hashes((staging / "map.bsp.hashes").string(), out_filename, report, lumpOrder);
+        cache->insert(cache_key, staging);
+    }
+    if (options.print_report) {
+        report.print();
+    } else if (report.tricoll.num_errors) {
+        report.tricoll.print();
+    }
+    return report.tricoll.num_errors ? 1 : 0;
+}
+
+
+int convert(const char *in_filename, const char *out_filename, ConvertOptions &options) {
+    Bsp r1bsp(in_filename);
+    return convert(r1bsp, in_filename, out_filename, options);
+}
@@ -0,0 +1,108 @@
+// validated, zero-copy view of the GAME_LUMP & its sprp (static props) sub-lump
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+#include "bsp.hpp"
+#include "source.hpp"
+#include "titanfall.hpp"
+#include "titanfall2.hpp"
+
+
+typedef char ModelDictEntry[128];
+
+
+// StaticProp is titanfall::StaticProp (sprp v12) or titanfall2::StaticProp (sprp v13)
+// -- every offset & count is checked against the lump once, here
+// -- so loops over the spans can index them without any further checks
+template <typename StaticProp>
+class GameLumpView { public:
+    std::span<const source::GameLumpHeader>  directory_;
+    const source::GameLumpHeader            *sprp_ = nullptr;  // nullptr if the map has no static props
+    std::span<const ModelDictEntry>          model_names_;
+    std::span<const uint16_t>                leaves_;  // v12 only
+    uint32_t                                 unknown_[2] = {0, 0};  // follows num_props
+    std::span<const StaticProp>              props_;
+
+    GameLumpView(Bsp &bsp) {
+        auto lump = bsp.get_lump<const char>(titanfall::GAME_LUMP);
+        uint32_t lump_offset = bsp.header_->lumps[titanfall::GAME_LUMP].offset;
+
+        uint32_t num_sub_lumps = read_u32(lump, 0, "sub-lump count");
+        if (num_sub_lumps > (lump.size() - 4) / sizeof(source::GameLumpHeader)) {
+            fail("sub-lump directory is larger than the lump");
+        }
+        directory_ = {reinterpret_cast<const source::GameLumpHeader*>(&lump[4]), num_sub_lumps};
+
+        for (const source::GameLumpHeader &header : directory_) {
+            if (header.id != MAGIC_sprp) { continue; }
+            // NOTE: offsets are from the start of the file, not the lump
+            if (header.offset < lump_offset || header.offset - lump_offset > lump.size()
+             || header.length > lump.size() - (header.offset - lump_offset)) {
+                fail("sprp sub-lump is outside the lump");
+            }
+            sprp_ = &header;
+            break;
+        }
+        if (sprp_ == nullptr) { return; }
+
+        int expected_version = sizeof(StaticProp) == sizeof(titanfall::StaticProp) ? titanfall::sprp_VERSION : titanfall2::sprp_VERSION;
+        if (sprp_->version != expected_version) {
+            fail("unexpected sprp version " + std::to_string(sprp_->version));
+        }
+
+        std::span<const char> sprp = lump.subspan(sprp_->offset - lump_offset, sprp_->length);
+        size_t readPtr = 0;
+        uint32_t num_models = read_u32(sprp, readPtr, "num_models");
+        readPtr += 4;
+        if (num_models > (sprp.size() - readPtr) / sizeof(ModelDictEntry)) {
+            fail("model dictionary is larger than the sub-lump");
+        }
+        model_names_ = {reinterpret_cast<const ModelDictEntry*>(&sprp[readPtr]), num_models};
+        readPtr += num_models * sizeof(ModelDictEntry);
+
+        if (sprp_->version == titanfall::sprp_VERSION) {
+            uint32_t num_leaves = read_u32(sprp, readPtr, "num_leaves");
+            readPtr += 4;
+            if (num_leaves > (sprp.size() - readPtr) / sizeof(uint16_t)) {
+                fail("leaves are larger than the sub-lump");
+            }
+            leaves_ = {reinterpret_cast<const uint16_t*>(&sprp[readPtr]), num_leaves};
+            readPtr += num_leaves * sizeof(uint16_t);
+        }
+
+        uint32_t num_props = read_u32(sprp, readPtr, "num_props");
+        unknown_[0] = read_u32(sprp, readPtr + 4, "unknown_1");
+        unknown_[1] = read_u32(sprp, readPtr + 8, "unknown_2");
+        readPtr += 12;
+        if (num_props > (sprp.size() - readPtr) / sizeof(StaticProp)) {
+            fail("props are larger than the sub-lump");
+        }
+        props_ = {reinterpret_cast<const StaticProp*>(&sprp[readPtr]), num_props};
+
+        // every prop must index a model name
+        for (const StaticProp &prop : props_) {
+            if (prop.model_name >= num_models) {
+                fail("prop model_name out of range");
+            }
+        }
+    }
+
+private:
+    static uint32_t read_u32(std::span<const char> data, size_t offset, const char *name) {
+        if (offset > data.size() || data.size() - offset < 4) {
+            fail(std::string(name) + " is past the end of the lump");
+        }
+        uint32_t value;
+        memcpy(&value, &data[offset], 4);
+        return value;
+    }
+
+    [[noreturn]] static void fail(const std::string &reason) {
+        throw std::runtime_error("Invalid GAME_LUMP: " + reason);
+    }
+};
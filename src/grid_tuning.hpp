@@ -0,0 +1,132 @@
+// re-tuned worldspawn CM grids: the same world area as r1's Grid, at another Grid.scale
+// -- addPropsToCmGrid re-buckets every worldspawn GeoSet (brush, tricoll & prop) into the new cells
+// -- candidate scales are compared w/ a cost model, see `cost`
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "bounds.hpp"
+#include "titanfall.hpp"
+
+
+namespace grid_tuning {
+    const float AUTO = -1;  // for ConvertOptions::cm_grid_scale, pick the cheapest candidate
+    const float MIN_SCALE = 64;
+    const uint32_t MAX_CELLS = 1 << 20;
+
+    // cost model
+    // -- a query of QUERY_SIZE units walks every GeoSet in ~(1 + QUERY_SIZE / scale)^2 cells
+    // -- & every BYTES_PER_GEO_SET bytes of CM_GRID lumps costs as much as walking 1 more GeoSet per query
+    const float QUERY_SIZE = 128;
+    const float BYTES_PER_GEO_SET = 65536;
+
+
+    struct Stats {
+        float     scale = 0;
+        int32_t   num_cells[2] = {};
+        uint32_t  geo_sets = 0;  // in worldspawn cells; a straddling GeoSet counts once per cell
+        uint32_t  unique_geo_sets = 0;
+        double    mean = 0;  // GeoSets per cell
+        uint32_t  p99 = 0;
+        uint32_t  max = 0;
+
+        double duplication() const {
+            return unique_geo_sets ? static_cast<double>(geo_sets) / unique_geo_sets : 1.0;
+        }
+
+        // GridCells, GeoSets & GeoSetBounds
+        uint64_t bytes() const {
+            return static_cast<uint64_t>(num_cells[0]) * num_cells[1] * sizeof(titanfall::GridCell)
+                 + static_cast<uint64_t>(geo_sets) * (sizeof(titanfall::GeoSet) + sizeof(titanfall::Bounds));
+        }
+
+        double cost() const {
+            double cells_per_query = (1.0 + QUERY_SIZE / scale) * (1.0 + QUERY_SIZE / scale);
+            return mean * cells_per_query + bytes() / BYTES_PER_GEO_SET;
+        }
+    };
+
+
+    // per_cell is the number of GeoSets in each worldspawn cell; sorted in place
+    Stats stats(const titanfall::Grid &layout, std::vector<uint32_t> &per_cell, uint32_t unique_geo_sets) {
+        Stats result;
+        result.scale = layout.scale;
+        result.num_cells[0] = layout.num_cells[0];
+        result.num_cells[1] = layout.num_cells[1];
+        result.unique_geo_sets = unique_geo_sets;
+        if (per_cell.empty()) { return result; }
+        std::sort(per_cell.begin(), per_cell.end());
+        for (uint32_t count : per_cell) { result.geo_sets += count; }
+        result.mean = static_cast<double>(result.geo_sets) / per_cell.size();
+        result.p99 = per_cell[std::min(per_cell.size() - 1, per_cell.size() * 99 / 100)];
+        result.max = per_cell.back();
+        return result;
+    }
+
+
+    // covers at least r1Grid's worldspawn cells
+    titanfall::Grid layout(const titanfall::Grid &r1Grid, float scale) {
+        titanfall::Grid grid = r1Grid;
+        grid.scale = scale;
+        for (int axis = 0; axis < 2; axis++) {
+            double min = static_cast<double>(r1Grid.cell_offset[axis]) * r1Grid.scale;
+            double max = static_cast<double>(r1Grid.cell_offset[axis] + r1Grid.num_cells[axis]) * r1Grid.scale;
+            grid.cell_offset[axis] = static_cast<int32_t>(floor(min / scale));
+            grid.num_cells[axis] = std::max(1, static_cast<int32_t>(ceil(max / scale)) - grid.cell_offset[axis]);
+        }
+        return grid;
+    }
+
+
+    // r1's scale, halved & doubled twice; only those w/ a manageable number of cells
+    std::vector<float> candidates(const titanfall::Grid &r1Grid) {
+        std::vector<float> scales;
+        for (float factor : {0.25f, 0.5f, 1.0f, 2.0f, 4.0f}) {
+            float scale = r1Grid.scale * factor;
+            titanfall::Grid grid = layout(r1Grid, scale);
+            if (scale >= MIN_SCALE && static_cast<uint64_t>(grid.num_cells[0]) * grid.num_cells[1] <= MAX_CELLS) {
+                scales.push_back(scale);
+            }
+        }
+        return scales;
+    }
+
+
+    // cells along axis that a box [min, max] could touch, w/ a cell of slack either side
+    // -- a superset of the cells testCollision accepts; non-finite bounds cover every cell, as they do there
+    void cellRange(const titanfall::Grid &layout, int axis, float min, float max, int &first, int &last) {
+        first = 0;
+        last = layout.num_cells[axis] - 1;
+        if (!std::isfinite(min) || !std::isfinite(max)) { return; }
+        double low  = floor((static_cast<double>(min) - 1) / layout.scale) - layout.cell_offset[axis] - 1;
+        double high = floor((static_cast<double>(max) + 1) / layout.scale) - layout.cell_offset[axis] + 1;
+        first = static_cast<int>(std::clamp(low,  0.0, static_cast<double>(last) + 1));
+        last  = static_cast<int>(std::clamp(high, -1.0, static_cast<double>(last)));
+    }
+
+
+    struct Report {
+        bool      retuned = false;
+        uint32_t  num_candidates = 0;
+        Stats     original;  // r1's layout, w/ props added
+        Stats     tuned;
+
+        void print(FILE *out = stdout) {
+            if (!retuned) { return; }
+            if (tuned.scale == original.scale && tuned.num_cells[0] == original.num_cells[0] && tuned.num_cells[1] == original.num_cells[1]) {
+                fprintf(out, "CM grid kept: r1's scale %g is the cheapest of %u candidates (cost %.2f)\n", original.scale, num_candidates, original.cost());
+                return;
+            }
+            fprintf(out, "CM grid re-tuned from %u candidates: scale %g -> %g, %dx%d -> %dx%d cells\n", num_candidates,
+                original.scale, tuned.scale, original.num_cells[0], original.num_cells[1], tuned.num_cells[0], tuned.num_cells[1]);
+            fprintf(out, "-- GeoSets per cell: mean %.2f -> %.2f, p99 %u -> %u, max %u -> %u\n",
+                original.mean, tuned.mean, original.p99, tuned.p99, original.max, tuned.max);
+            fprintf(out, "-- GeoSets: %u -> %u (duplication %.2fx -> %.2fx), cost %.2f -> %.2f\n",
+                original.geo_sets, tuned.geo_sets, original.duplication(), tuned.duplication(), original.cost(), tuned.cost());
+        }
+    };
+};
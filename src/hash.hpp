@@ -0,0 +1,119 @@
+// fast 64-bit hash for lump & file integrity digests
+// NOTE: modelled on XXH3's SSE2 stripe loop (but NOT compatible w/ XXH3, don't compare against xxhsum)
+// -- 64 byte stripes accumulate into 8 lanes, scrambled every 1 KiB
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+
+namespace hash {
+    const uint64_t PRIME_1 = 0x9E3779B185EBCA87ull;
+    const uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4Full;
+    const uint64_t PRIME_3 = 0x165667B19E3779F9ull;
+    const uint32_t PRIME32 = 0x9E3779B1u;
+
+    // key material, XORed into each stripe; 64 bytes + room to slide 2 bytes per stripe
+    alignas(16) const uint64_t SECRET[10] = {
+        0xBE4BA423396CFEB8ull, 0x1CAD21F72C81017Cull, 0xDB979083E96DD4DEull, 0x1F67B3B7A4A44072ull,
+        0x78E5C0CC4EE679CBull, 0x2172FFCC7DD05A82ull, 0x8E2443F7744608B8ull, 0x4C263A81E69035E0ull,
+        0xCD0D7B75B1F5E3A9ull, 0x64B5F0C2A3B1E8D7ull};
+
+    inline uint64_t read64(const char *data) {
+        uint64_t value;
+        memcpy(&value, data, 8);
+        return value;
+    }
+
+    // low ^ high of the 128-bit product
+    inline uint64_t mul_fold(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+        unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+        return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#else
+        uint64_t high;
+        uint64_t low = _umul128(a, b, &high);
+        return low ^ high;
+#endif
+    }
+
+    inline uint64_t avalanche(uint64_t h) {
+        h ^= h >> 37;
+        h *= PRIME_3;
+        return h ^ (h >> 32);
+    }
+
+    // acc += (lo32(d ^ k) * hi32(d ^ k)) + swap64(d), 2 lanes per register
+    inline void accumulate_stripe(__m128i acc[4], const char *data, const char *secret) {
+        for (int i = 0; i < 4; i++) {
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data) + i);
+            __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(secret) + i);
+            __m128i dk = _mm_xor_si128(d, k);
+            __m128i product = _mm_mul_epu32(dk, _mm_shuffle_epi32(dk, _MM_SHUFFLE(0, 3, 0, 1)));
+            __m128i swapped = _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+            acc[i] = _mm_add_epi64(acc[i], _mm_add_epi64(product, swapped));
+        }
+    }
+
+    // acc = (acc ^ (acc >> 47) ^ k) * PRIME32, keeps high bits from piling up
+    inline void scramble(__m128i acc[4], const char *secret) {
+        const __m128i prime = _mm_set1_epi32(static_cast<int>(PRIME32));
+        for (int i = 0; i < 4; i++) {
+            __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(secret) + i);
+            __m128i a = _mm_xor_si128(_mm_xor_si128(acc[i], _mm_srli_epi64(acc[i], 47)), k);
+            __m128i low  = _mm_mul_epu32(a, prime);
+            __m128i high = _mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+            acc[i] = _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+        }
+    }
+
+    uint64_t hash64(const void *input, size_t length, uint64_t seed = 0) {
+        const char *data = static_cast<const char*>(input);
+        const char *secret = reinterpret_cast<const char*>(SECRET);
+        uint64_t h = seed ^ (length * PRIME_1);
+        if (length < 64) {  // short inputs: 8 bytes at a time, then the tail
+            size_t i = 0;
+            for (; i + 8 <= length; i += 8) {
+                h = mul_fold(h ^ read64(&data[i]), PRIME_2 ^ SECRET[(i / 8) & 7]);
+            }
+            if (i < length) {
+                uint64_t tail = 0;
+                memcpy(&tail, &data[i], length - i);
+                h = mul_fold(h ^ tail, PRIME_3);
+            }
+            return avalanche(h);
+        }
+
+        alignas(16) uint64_t lanes[8] = {PRIME32, PRIME_1, PRIME_2, PRIME_3, PRIME_2 ^ seed, PRIME_1 ^ seed, PRIME_3, PRIME32};
+        __m128i acc[4];
+        for (int i = 0; i < 4; i++) { acc[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(lanes) + i); }
+        size_t num_stripes = (length - 1) / 64;  // the last (maybe partial) stripe is handled below
+        for (size_t s = 0; s < num_stripes; s++) {
+            // NOTE: offset the secret per stripe like XXH3, so repeated stripes don't cancel
+            accumulate_stripe(acc, &data[s * 64], &secret[(s & 7) * 2]);
+            if ((s & 15) == 15) { scramble(acc, secret); }
+        }
+        accumulate_stripe(acc, &data[length - 64], secret);  // overlaps the previous stripe
+
+        for (int i = 0; i < 4; i++) { _mm_store_si128(reinterpret_cast<__m128i*>(lanes) + i, acc[i]); }
+        for (int i = 0; i < 8; i += 2) {
+            h += mul_fold(lanes[i] ^ SECRET[i], lanes[i + 1] ^ SECRET[i + 1]);
+        }
+        return avalanche(h);
+    }
+
+
+    // hex, zero padded
+    void to_hex(uint64_t value, char (&out)[17]) {
+        const char *digits = "0123456789abcdef";
+        for (int i = 15; i >= 0; i--, value >>= 4) {
+            out[i] = digits[value & 0xF];
+        }
+        out[16] = '\0';
+    }
+};
@@ -0,0 +1,302 @@
+// r1 -> r2 lump registry: how each lump is converted, sized & written
+// -- every lump index gets a Lump<INDEX> (raw copy by default)
+// -- planning, dispatch & validation all read from the tables at the bottom
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bsp.hpp"
+#include "game_lump.hpp"
+#include "source.hpp"
+#include "static_props.hpp"
+#include "titanfall.hpp"
+#include "titanfall2.hpp"
+
+
+namespace lumps {
+    // conversion task which generates a lump; lumps can't be sized until it has run
+    enum class Stage { NONE, TRICOLL, CM_GRID };
+
+    enum class Kind {
+        COPY,         // raw bytes, unchanged
+        ELEMENTWISE,  // each r1 element converted to an r2 element
+        NULLED,       // one r2 element of nulls per r1 element
+        GENERATED,    // copied from GeneratedLumps
+        GAME_LUMP,    // sprp v12 -> v13
+    };
+
+    const int KEEP_VERSION = -1;
+
+    struct Descriptor {
+        const char *name;
+        Kind        kind;
+        Stage       stage;
+        uint32_t    r1_element_size;
+        uint32_t    r2_element_size;
+        int         r2_version;  // KEEP_VERSION copies the r1 LumpHeader.version
+    };
+
+
+    // outputs of convertTricoll & addPropsToCmGrid
+    struct GeneratedLumps {
+        std::vector<titanfall::TricollHeader>  tricoll_headers;
+        std::vector<uint32_t>                  bevel_indices;
+        std::vector<uint16_t>                  bevel_starts;
+        titanfall::Grid                        grid;
+        std::vector<titanfall::GridCell>       grid_cells;
+        std::vector<titanfall::GeoSet>         geo_sets;
+        std::vector<titanfall::Bounds>         geo_set_bounds;
+        std::vector<uint32_t>                  primitives;
+        std::vector<titanfall::Bounds>         primitive_bounds;
+        std::vector<uint32_t>                  unique_contents;
+    };
+
+
+    // everything a lump can be converted from
+    struct Sources {
+        Bsp                                  &r1bsp;
+        GameLumpView<titanfall::StaticProp>  &game_lump;
+        GeneratedLumps                       &generated;
+    };
+
+
+    template <typename T>
+    std::span<const char> as_bytes(const std::vector<T> &v) {
+        return {reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T)};
+    }
+
+    template <typename T>
+    std::span<const char> as_bytes(const T &single) {
+        return {reinterpret_cast<const char*>(&single), sizeof(T)};
+    }
+
+
+    // default: raw copy
+    template <int INDEX>
+    struct Lump {
+        typedef char r1_type;
+        typedef char r2_type;
+        static constexpr Descriptor descriptor = {"RAW", Kind::COPY, Stage::NONE, 1, 1, KEEP_VERSION};
+    };
+
+    #define COPY_LUMP(INDEX, T, SIZE) \
+        template <> struct Lump<titanfall::INDEX> { \
+            typedef T r1_type; \
+            typedef T r2_type; \
+            static_assert(sizeof(T) == SIZE); \
+            static constexpr Descriptor descriptor = {#INDEX, Kind::COPY, Stage::NONE, SIZE, SIZE, KEEP_VERSION}; \
+        };
+
+    #define GENERATED_LUMP(INDEX, T, SIZE, STAGE, MEMBER) \
+        template <> struct Lump<titanfall::INDEX> { \
+            typedef T r1_type; \
+            typedef T r2_type; \
+            static_assert(sizeof(T) == SIZE); \
+            static constexpr Descriptor descriptor = {#INDEX, Kind::GENERATED, Stage::STAGE, SIZE, SIZE, KEEP_VERSION}; \
+            static constexpr auto member = &GeneratedLumps::MEMBER; \
+        };
+
+    COPY_LUMP(MODELS,               titanfall::Model, 0x20)
+    COPY_LUMP(TRICOLL_TRIS,         uint32_t,         0x04)
+    COPY_LUMP(TRICOLL_BEVEL_STARTS, uint16_t,         0x02)
+
+    GENERATED_LUMP(TRICOLL_HEADER,        titanfall::TricollHeader, 0x2C, TRICOLL, tricoll_headers)
+    GENERATED_LUMP(TRICOLL_BEVEL_INDICES, uint32_t,                 0x04, TRICOLL, bevel_indices)
+    GENERATED_LUMP(CM_GRID,               titanfall::Grid,          0x1C, CM_GRID, grid)
+    GENERATED_LUMP(CM_GRID_CELLS,         titanfall::GridCell,      0x04, CM_GRID, grid_cells)
+    GENERATED_LUMP(CM_GEO_SETS,           titanfall::GeoSet,        0x08, CM_GRID, geo_sets)
+    GENERATED_LUMP(CM_GEO_SET_BOUNDS,     titanfall::Bounds,        0x10, CM_GRID, geo_set_bounds)
+    GENERATED_LUMP(CM_PRIMITIVES,         uint32_t,                 0x04, CM_GRID, primitives)
+    GENERATED_LUMP(CM_PRIMITIVE_BOUNDS,   titanfall::Bounds,        0x10, CM_GRID, primitive_bounds)
+    GENERATED_LUMP(CM_UNIQUE_CONTENTS,    uint32_t,                 0x04, CM_GRID, unique_contents)
+
+    #undef COPY_LUMP
+    #undef GENERATED_LUMP
+
+    template <>
+    struct Lump<titanfall::GAME_LUMP> {
+        typedef char r1_type;
+        typedef char r2_type;
+        static constexpr Descriptor descriptor = {"GAME_LUMP", Kind::GAME_LUMP, Stage::NONE, 1, 1, KEEP_VERSION};
+    };
+
+    template <>
+    struct Lump<titanfall::LIGHTPROBE_REFS> {
+        typedef titanfall::LightProbeRef  r1_type;
+        typedef titanfall2::LightProbeRef r2_type;
+        static_assert(sizeof(r1_type) == 0x10 && sizeof(r2_type) == 0x14);
+        static constexpr Descriptor descriptor = {"LIGHTPROBE_REFS", Kind::ELEMENTWISE, Stage::NONE, 0x10, 0x14, KEEP_VERSION};
+
+        static r2_type convert(const r1_type &lpr) {
+            return {.origin = lpr.origin, .probe = lpr.probe, .unknown = 0};
+        }
+    };
+
+    template <>
+    struct Lump<titanfall::REAL_TIME_LIGHTS> {
+        typedef uint32_t                  r1_type;  // texel
+        typedef titanfall2::RealTimeLight r2_type;
+        static_assert(sizeof(r1_type) == 0x04 && sizeof(r2_type) == 0x09);
+        static constexpr Descriptor descriptor = {"REAL_TIME_LIGHTS", Kind::NULLED, Stage::NONE, 0x04, 0x09, KEEP_VERSION};
+    };
+
+
+    // GameLumpHeader, model_names, num_props + unknown_1 & unknown_2, props, unknown3 count
+    uint32_t game_lump_length(GameLumpView<titanfall::StaticProp> &game_lump) {
+        return static_cast<uint32_t>(4 + sizeof(source::GameLumpHeader)
+            + 4 + game_lump.model_names_.size() * sizeof(ModelDictEntry)
+            + 12 + game_lump.props_.size() * sizeof(titanfall2::StaticProp) + 4);
+    }
+
+
+    // offset is where out will be in the file
+    void write_game_lump(GameLumpView<titanfall::StaticProp> &game_lump, char *out, uint32_t offset) {
+        uint32_t writePtr = 4 + sizeof(source::GameLumpHeader);
+        // copy num_model_names + model_name table
+        uint32_t num_model_names = static_cast<uint32_t>(game_lump.model_names_.size());
+        memcpy(&out[writePtr], &num_model_names, 4);
+        if (num_model_names) {  // data() is nullptr for an empty span
+            memcpy(&out[writePtr + 4], game_lump.model_names_.data(), num_model_names * sizeof(ModelDictEntry));
+        }
+        writePtr += 4 + num_model_names * sizeof(ModelDictEntry);
+        // NOTE: num_leaves is always 0 in r1; we can just ignore it
+        // copy num_props + unknown_1 & unknown_2
+        uint32_t num_props = static_cast<uint32_t>(game_lump.props_.size());
+        memcpy(&out[writePtr], &num_props, 4);
+        memcpy(&out[writePtr + 4], game_lump.unknown_, 8);
+        writePtr += 12;
+        convert_static_props(reinterpret_cast<const char*>(game_lump.props_.data()), &out[writePtr], num_props);
+        writePtr += num_props * sizeof(titanfall2::StaticProp);
+        memset(&out[writePtr], 0, 4);  // unknown3 count
+        writePtr += 4;
+        uint32_t  num_game_lumps = 1;
+        source::GameLumpHeader glh;
+        glh = {
+            .id       = MAGIC_sprp,
+            .flags    = 0x0000,
+            .version  = titanfall2::sprp_VERSION,
+            .offset   = offset + 20,
+            .length   = writePtr - 20};
+        memcpy(&out[0], &num_game_lumps, 4);
+        memcpy(&out[4], &glh, sizeof(glh));
+    }
+
+
+    // length of the r2 lump; GENERATED lumps are only valid once their Stage has run
+    template <int INDEX>
+    uint32_t length(Sources &sources) {
+        typedef Lump<INDEX> L;
+        uint32_t r1_length = sources.r1bsp.header_->lumps[INDEX].length;
+        if constexpr (L::descriptor.kind == Kind::GENERATED) {
+            return static_cast<uint32_t>(as_bytes(sources.generated.*L::member).size());
+        } else if constexpr (L::descriptor.kind == Kind::GAME_LUMP) {
+            return game_lump_length(sources.game_lump);
+        } else {
+            return r1_length / L::descriptor.r1_element_size * L::descriptor.r2_element_size;
+        }
+    }
+
+
+    template <int INDEX>
+    void write(Sources &sources, char *out, uint32_t offset) {
+        typedef Lump<INDEX> L;
+        Bsp &r1bsp = sources.r1bsp;
+        LumpHeader &r1lump = r1bsp.header_->lumps[INDEX];
+        if constexpr (L::descriptor.kind == Kind::COPY) {
+            memcpy(out, r1bsp.file_.rawdata(r1lump.offset), r1lump.length);
+        } else if constexpr (L::descriptor.kind == Kind::ELEMENTWISE) {
+            auto r1 = r1bsp.get_lump<typename L::r1_type>(INDEX);
+            for (size_t i = 0; i < r1.size(); i++) {
+                typename L::r2_type r2 = L::convert(r1[i]);
+                memcpy(&out[i * sizeof(r2)], &r2, sizeof(r2));
+            }
+        } else if constexpr (L::descriptor.kind == Kind::NULLED) {
+            memset(out, 0, length<INDEX>(sources));
+        } else if constexpr (L::descriptor.kind == Kind::GENERATED) {
+            std::span<const char> bytes = as_bytes(sources.generated.*L::member);
+            if (!bytes.empty()) { memcpy(out, bytes.data(), bytes.size()); }
+        } else if constexpr (L::descriptor.kind == Kind::GAME_LUMP) {
+            write_game_lump(sources.game_lump, out, offset);
+        }
+    }
+
+
+    // the lump's bytes as written, if they already exist somewhere (COPY & GENERATED); false if it must be written
+    // -- lets a streamed conversion send them w/o buffering a copy
+    template <int INDEX>
+    bool view(Sources &sources, std::span<const char> &bytes) {
+        typedef Lump<INDEX> L;
+        Bsp &r1bsp = sources.r1bsp;
+        LumpHeader &r1lump = r1bsp.header_->lumps[INDEX];
+        if constexpr (L::descriptor.kind == Kind::COPY) {
+            bytes = {r1bsp.file_.rawdata(r1lump.offset), r1lump.length};
+            return true;
+        } else if constexpr (L::descriptor.kind == Kind::GENERATED) {
+            bytes = as_bytes(sources.generated.*L::member);
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+
+    typedef uint32_t (*LengthFn)(Sources &sources);
+    typedef void     (*WriteFn)(Sources &sources, char *out, uint32_t offset);
+    typedef bool     (*ViewFn)(Sources &sources, std::span<const char> &bytes);
+
+    template <size_t... I>
+    constexpr std::array<Descriptor, 128> make_descriptors(std::index_sequence<I...>) {
+        return {Lump<static_cast<int>(I)>::descriptor...};
+    }
+
+    template <size_t... I>
+    constexpr std::array<LengthFn, 128> make_lengths(std::index_sequence<I...>) {
+        return {&length<static_cast<int>(I)>...};
+    }
+
+    template <size_t... I>
+    constexpr std::array<WriteFn, 128> make_writers(std::index_sequence<I...>) {
+        return {&write<static_cast<int>(I)>...};
+    }
+
+    template <size_t... I>
+    constexpr std::array<ViewFn, 128> make_views(std::index_sequence<I...>) {
+        return {&view<static_cast<int>(I)>...};
+    }
+
+    constexpr std::array<Descriptor, 128> DESCRIPTORS = make_descriptors(std::make_index_sequence<128>{});
+    constexpr std::array<LengthFn, 128>   LENGTHS     = make_lengths(std::make_index_sequence<128>{});
+    constexpr std::array<WriteFn, 128>    WRITERS     = make_writers(std::make_index_sequence<128>{});
+    constexpr std::array<ViewFn, 128>     VIEWS       = make_views(std::make_index_sequence<128>{});
+
+
+    uint32_t r2_version(int index, const LumpHeader &r1lump) {
+        int version = DESCRIPTORS[index].r2_version;
+        return version == KEEP_VERSION ? r1lump.version : static_cast<uint32_t>(version);
+    }
+
+
+    // every r1 lump must be inside the file & a whole number of elements
+    void validate(Bsp &r1bsp) {
+        size_t file_size = r1bsp.file_.size();
+        for (int i = 0; i < 128; i++) {
+            LumpHeader &lump = r1bsp.header_->lumps[i];
+            if (lump.offset == 0) { continue; }
+            const Descriptor &descriptor = DESCRIPTORS[i];
+            if (lump.offset > file_size || lump.length > file_size - lump.offset) {
+                throw std::runtime_error("Lump " + std::to_string(i) + " is outside the file");
+            }
+            if (lump.length % descriptor.r1_element_size != 0) {
+                throw std::runtime_error(std::string(descriptor.name) + " is not a whole number of "
+                    + std::to_string(descriptor.r1_element_size) + " byte elements");
+            }
+        }
+    }
+};
@@ -4,6 +4,7 @@
 #include <cstring>
 #include <string>
 #include <string_view>
+#include <utility>
 
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -32,10 +33,15 @@ class memory_mapped_file
 #endif
     char* data_{};
     bool exists_{false};
+    bool borrowed_{false};  // open_memory
+    bool anonymous_{false};  // open_anonymous
 
 public:
     bool open_existing(const char* filename);
     bool open_new(const char* filename, size_t size);
+    void open_memory(char* data, size_t size);
+    void open_anonymous(size_t size);
+    void swap(memory_mapped_file& other);
     void fill(uint8_t filler);
     void set_size_and_close(size_t new_size);
     void close();
@@ -53,6 +59,31 @@ public:
 #endif
 };
 
+// a view of memory the caller owns (& keeps alive), w/o a file behind it; close() leaves the memory alone
+void memory_mapped_file::open_memory(char* data, size_t size) {
+    data_ = data;
+#ifdef _WIN32
+    size_.QuadPart = static_cast<LONGLONG>(size);
+#else
+    size_ = size;
+#endif
+    exists_ = true;
+    borrowed_ = true;
+}
+
+// swaps mappings (& ownership of them) w/ other
+void memory_mapped_file::swap(memory_mapped_file& other) {
+    std::swap(size_, other.size_);
+    std::swap(file_, other.file_);
+#ifdef _WIN32
+    std::swap(mapping_, other.mapping_);
+#endif
+    std::swap(data_, other.data_);
+    std::swap(exists_, other.exists_);
+    std::swap(borrowed_, other.borrowed_);
+    std::swap(anonymous_, other.anonymous_);
+}
+
 #ifdef _WIN32
 // Windows
 bool memory_mapped_file::open_existing(const char* filename)
@@ -109,6 +140,16 @@ bool memory_mapped_file::open_new(const char* filename, size_t size) {
     return true;
 }
 
+// zeroed, writable memory w/o a file behind it (e.g. for a decompressed map)
+void memory_mapped_file::open_anonymous(size_t size) {
+    data_ = reinterpret_cast<char*>(VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+    if (data_ == nullptr) [[unlikely]]
+        throw std::runtime_error("Failed allocating " + std::to_string(size) + " bytes (" + std::to_string(GetLastError()) + ")");
+    size_.QuadPart = static_cast<LONGLONG>(size);
+    exists_ = true;
+    anonymous_ = true;
+}
+
 void memory_mapped_file::fill(uint8_t filler) {
     memset(data_, filler, size_.QuadPart);
 }
@@ -147,6 +188,15 @@ void memory_mapped_file::set_size_and_close(size_t new_size) {
 }
 
 void memory_mapped_file::close() {
+    if (borrowed_) {
+        data_ = nullptr;
+        borrowed_ = false;
+    }
+    if (anonymous_) {
+        VirtualFree(data_, 0, MEM_RELEASE);
+        data_ = nullptr;
+        anonymous_ = false;
+    }
     if (data_ != nullptr) {
         UnmapViewOfFile(data_);
         data_ = nullptr;
@@ -170,16 +220,20 @@ void memory_mapped_file::close() {
 bool memory_mapped_file::open_existing(const char* filename) {
     struct stat sb;
     file_ = open(filename, O_RDONLY, 00666);
-    if (file_ == -1)
+    if (file_ == -1) {
+        file_ = 0;  // so close() doesn't try to close it
         throw std::runtime_error("Failed opening file: "s + filename + " (" + std::to_string(errno) + ")");
+    }
 
     if (fstat(file_, &sb) == -1)
         throw std::runtime_error("Failed fstating file: "s + filename + " (" + std::to_string(errno) + ")");
     size_ = sb.st_size;
 
     data_ = reinterpret_cast<char*>(mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, file_, 0));
-    if (data_ == MAP_FAILED)
+    if (data_ == MAP_FAILED) {
+        data_ = nullptr;  // so close() doesn't try to unmap it
         throw std::runtime_error("Failed creating file mapping: "s + filename+ " (" + std::to_string(errno) + ")");
+    }
 
     exists_ = true;
     size_ = sb.st_size;
@@ -188,30 +242,51 @@ bool memory_mapped_file::open_existing(const char* filename) {
 
 bool memory_mapped_file::open_new(const char* filename, size_t size) {
     file_ = open(filename, O_CREAT | O_RDWR, 00666);
-    if (file_ == -1)
+    if (file_ == -1) {
+        file_ = 0;  // so close() doesn't try to close it
         throw std::runtime_error("Failed opening file: "s + filename + " (" + std::to_string(errno) + ")");
+    }
 
     if (ftruncate(file_, size) == -1)
         throw std::runtime_error("Failed ftruncating file: "s + filename + " (" + std::to_string(errno) + ")");
 
     data_ = reinterpret_cast<char*>(mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file_, 0));
-    if (data_ == MAP_FAILED)
+    if (data_ == MAP_FAILED) {
+        data_ = nullptr;
         throw std::runtime_error("Failed creating file mapping: "s + filename);
+    }
 
     exists_ = true;
     size_ = size;
     return true;
 }
 
+// zeroed, writable memory w/o a file behind it (e.g. for a decompressed map)
+void memory_mapped_file::open_anonymous(size_t size) {
+    data_ = reinterpret_cast<char*>(mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (data_ == MAP_FAILED) {
+        data_ = nullptr;
+        throw std::runtime_error("Failed mapping " + std::to_string(size) + " bytes (" + std::to_string(errno) + ")");
+    }
+    size_ = size;
+    exists_ = true;
+    anonymous_ = true;
+}
+
 void memory_mapped_file::fill(uint8_t filler) {
     memset(data_, filler, size_);
 }
 
 void memory_mapped_file::close() {
+    if (borrowed_) {
+        data_ = nullptr;
+        borrowed_ = false;
+    }
     if (data_) {
         if (munmap(data_, size_) == -1)
             throw std::runtime_error("Failed munmaping file (" + std::to_string(errno) + ")");
         data_ = nullptr;
+        anonymous_ = false;
     }
     if (file_) {
         if (::close(file_) == -1)
@@ -1,6 +1,12 @@
 #pragma once
 
 #include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #include "common.hpp"
 #include "memory_mapped_file.hpp"
@@ -15,6 +21,31 @@ struct mstudiopertrihdr_t {
 };
 
 
+// NOTE: node layout is inferred & hasn't been checked against real r1 .mdl files yet
+// -- so footprints are opt-in (ConvertOptions::footprint_depth), & Model::getFootprint validates every tree it walks
+struct mstudiopertrinode_t {
+    uint16_t  mins[3];  // quantised across mstudiopertrihdr_t bbmin -> bbmax
+    uint16_t  maxs[3];
+    uint16_t  first_child;  // children are first_child & first_child + 1
+    uint16_t  flags;
+};
+
+#define PERTRI_NODE_LEAF  0x0001
+
+static_assert(sizeof(mstudiopertrinode_t) == 0x10);
+static_assert(offsetof(mstudiopertrinode_t, mins)        == 0x00);
+static_assert(offsetof(mstudiopertrinode_t, maxs)        == 0x06);
+static_assert(offsetof(mstudiopertrinode_t, first_child) == 0x0C);
+static_assert(offsetof(mstudiopertrinode_t, flags)       == 0x0E);
+
+
+// local space box around some of a model's collision geometry
+struct LocalBox {
+    Vector3  mins;
+    Vector3  maxs;
+};
+
+
 struct studiohdr_t {
     int32_t   id;  // Model format ID (e.g. "IDST" [0x49, 0x44, 0x53, 0x54])
     int32_t   version;  // Format version number
@@ -115,7 +146,15 @@ public:
             snprintf(buffer, 1024, "Failed to open file %s", filename);
             throw std::runtime_error(buffer);
         }
+        // NOTE: offsets in the headers are only trusted once checked against the file size
+        if (file_.size() < sizeof(studiohdr_t)) {
+            throw std::runtime_error(std::string("Model is too small: ") + filename);
+        }
         header_ = file_.rawdata<studiohdr_t>();
+        if (header_->studiohdr2_index < 0 || header_->studiohdr2_index % 4 != 0
+         || static_cast<size_t>(header_->studiohdr2_index) > file_.size() - sizeof(studiohdr2_t)) {
+            throw std::runtime_error(std::string("Model studiohdr2_index is invalid: ") + filename);
+        }
         header2_ = file_.rawdata<studiohdr2_t>(header_->studiohdr2_index);
     }
 
@@ -123,12 +162,130 @@ public:
         file_.close();
     }
 
+    // 0 if the model has no per-tri AABB tree, or if it would be outside the file
     mstudiopertrihdr_t *getPerTriHeader() {
-        if (header2_->per_tri_AABB_index == 0) { return 0; }
+        if (header2_->per_tri_AABB_index <= 0 || header2_->per_tri_AABB_index % 4 != 0) { return 0; }
+        size_t offset = static_cast<size_t>(header_->studiohdr2_index) + header2_->per_tri_AABB_index;
+        if (offset > file_.size() || file_.size() - offset < sizeof(mstudiopertrihdr_t)) { return 0; }
         return file_.rawdata<mstudiopertrihdr_t>(header_->studiohdr2_index + header2_->per_tri_AABB_index);
     }
 
+    // boxes from the per-tri AABB tree, down to max_depth; just the root bbox if max_depth is 0
+    // -- falls back to the root bbox if the tree is missing or malformed
+    std::vector<LocalBox> getFootprint(int max_depth) {
+        mstudiopertrihdr_t *perTri = getPerTriHeader();
+        std::vector<LocalBox> boxes;
+        if (perTri == 0) { return boxes; }
+        LocalBox root = {perTri->bbmin, perTri->bbmax};
+        if (max_depth <= 0) { return {root}; }
+
+        uint32_t node_count = static_cast<uint32_t>(header2_->per_tri_AABB_node_count);
+        size_t first_node = header_->studiohdr2_index + header2_->per_tri_AABB_index + sizeof(mstudiopertrihdr_t);
+        if (perTri->version != 2 || node_count == 0 || node_count > 0xFFFF
+         || node_count * sizeof(mstudiopertrinode_t) > file_.size() - first_node) {
+            return {root};
+        }
+        mstudiopertrinode_t *nodes = file_.rawdata<mstudiopertrinode_t>(first_node);
+
+        // padded by a quantisation step, so rounding can't shrink a box inside the geometry it covers
+        Vector3 step = {(root.maxs.x - root.mins.x) / 65535.0f, (root.maxs.y - root.mins.y) / 65535.0f, (root.maxs.z - root.mins.z) / 65535.0f};
+        auto dequantise = [&root, &step](const uint16_t (&q)[3], float pad) -> Vector3 {
+            return {
+                root.mins.x + (root.maxs.x - root.mins.x) * (q[0] / 65535.0f) + pad * step.x,
+                root.mins.y + (root.maxs.y - root.mins.y) * (q[1] / 65535.0f) + pad * step.y,
+                root.mins.z + (root.maxs.z - root.mins.z) * (q[2] / 65535.0f) + pad * step.z};
+        };
+        // a child outside its parent means the layout isn't what we think it is
+        auto contains = [](const mstudiopertrinode_t &parent, const mstudiopertrinode_t &child) {
+            for (int axis = 0; axis < 3; axis++) {
+                if (child.mins[axis] > child.maxs[axis] || child.mins[axis] < parent.mins[axis] || child.maxs[axis] > parent.maxs[axis]) {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        struct Entry { uint16_t node; int depth; };
+        std::vector<Entry> stack = {{0, 0}};
+        while (!stack.empty()) {
+            Entry entry = stack.back();
+            stack.pop_back();
+            mstudiopertrinode_t &node = nodes[entry.node];
+            bool leaf = (node.flags & PERTRI_NODE_LEAF) != 0;
+            if (leaf || entry.depth == max_depth) {
+                boxes.push_back({dequantise(node.mins, -1), dequantise(node.maxs, 1)});
+                continue;
+            }
+            // children must come after their parent, or we could loop forever
+            if (node.first_child <= entry.node || node.first_child + 1u >= node_count
+             || !contains(node, nodes[node.first_child]) || !contains(node, nodes[node.first_child + 1])) {
+                return {root};
+            }
+            stack.push_back({static_cast<uint16_t>(node.first_child),     entry.depth + 1});
+            stack.push_back({static_cast<uint16_t>(node.first_child + 1), entry.depth + 1});
+        }
+        return boxes;
+    }
+
     uint32_t getContents() {
         return header_->contents;
     }
 };
+
+
+// what a conversion needs from each model, w/o keeping the .mdl mapped
+struct ModelMetadata {
+    mstudiopertrihdr_t     per_tri;
+    std::vector<LocalBox>  footprint;
+    uint32_t               contents;
+};
+
+
+// ModelMetadata by path, kept warm across conversions (e.g. by --watch)
+// -- an entry is reloaded once the file's size or mtime changes
+// -- shared by concurrent conversions
+class ModelCache { public:
+    // throws like Model does, & if the model has no per-tri AABB header
+    ModelMetadata get(const std::string &path, int footprint_depth) {
+        std::error_code error;
+        uint64_t size = std::filesystem::file_size(path, error);
+        auto mtime = std::filesystem::last_write_time(path, error);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto found = entries_.find(path);
+            if (!error && found != entries_.end() && found->second.size == size && found->second.mtime == mtime
+             && found->second.footprint_depth == footprint_depth) {
+                hits_++;
+                return found->second.metadata;
+            }
+        }
+        // NOTE: loaded outside the lock, so 2 threads may load the same model once each
+        Model model {path.c_str()};
+        mstudiopertrihdr_t *perTri = model.getPerTriHeader();
+        if (perTri == 0) {
+            throw std::runtime_error("Model has no per-tri AABB header: " + path);
+        }
+        ModelMetadata metadata = {*perTri, model.getFootprint(footprint_depth), model.getContents()};
+        std::lock_guard<std::mutex> lock(mutex_);
+        misses_++;
+        if (!error) { entries_[path] = {size, mtime, footprint_depth, metadata}; }
+        return metadata;
+    }
+
+    void invalidate(const std::string &path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.erase(path);
+    }
+
+    uint32_t hits_ = 0, misses_ = 0;
+
+  private:
+    struct Entry {
+        uint64_t                          size;
+        std::filesystem::file_time_type   mtime;
+        int                               footprint_depth;
+        ModelMetadata                     metadata;
+    };
+    std::mutex                     mutex_;
+    std::map<std::string, Entry>   entries_;
+};
@@ -0,0 +1,222 @@
+// content addressed cache of converted maps, shared by concurrent converters
+// -- keyed by the input .bsp bytes, the size & mtime of each model it references, the converter build
+// -- & any convert settings that change the output (see `settings`)
+// -- each entry is a directory <key>/ holding map.bsp, map.bsp.hashes & any external lumps, renamed into place once complete
+// -- entry mtimes are bumped on each hit; the least recently used entries are evicted past max_bytes
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <system_error>
+#include <random>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+#include "bsp.hpp"
+#include "game_lump.hpp"
+#include "hash.hpp"
+#include "titanfall.hpp"
+
+// NOTE: any rebuild of the converter invalidates the cache; release builds can pin this to a version
+#ifndef BSP_REGEN_BUILD_ID
+#define BSP_REGEN_BUILD_ID __DATE__ " " __TIME__
+#endif
+
+
+class OutputCache { public:
+    enum class Materialised { NONE, REFLINK, HARDLINK, COPY };
+
+    std::filesystem::path  dir_;
+    uint64_t               max_bytes_;
+
+    OutputCache(const std::filesystem::path &dir, uint64_t max_bytes) : dir_(dir), max_bytes_(max_bytes) {
+        std::filesystem::create_directories(dir_);
+    }
+
+    // model_path is where each model in the GAME_LUMP's dictionary is loaded from
+    static uint64_t key(Bsp &r1bsp, GameLumpView<titanfall::StaticProp> &gameLump,
+                        const std::function<std::string(const ModelDictEntry&)> &model_path, uint64_t settings) {
+        const char build_id[] = BSP_REGEN_BUILD_ID;
+        uint64_t key = hash::hash64(build_id, sizeof(build_id) - 1, settings);
+        key = hash::hash64(r1bsp.file_.rawdata(), r1bsp.file_.size(), key);
+        for (const ModelDictEntry &entry : gameLump.model_names_) {
+            std::string name(entry, strnlen(entry, sizeof(ModelDictEntry)));
+            std::error_code error;
+            std::filesystem::path path = model_path(entry);
+            // NOTE: a missing model hashes as size 0; the conversion will fail on it anyway
+            uint64_t metadata[2] = {std::filesystem::file_size(path, error), 0};
+            if (!error) {
+                metadata[1] = static_cast<uint64_t>(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+            }
+            key = hash::hash64(name.data(), name.size(), key);
+            key = hash::hash64(metadata, sizeof(metadata), key);
+        }
+        return key;
+    }
+
+    std::filesystem::path entry(uint64_t key) const {
+        char hex[17];
+        hash::to_hex(key, hex);
+        return dir_ / hex;
+    }
+
+    // materialises a hit as out_filename (& its .hashes, if wanted); any failure is treated as a miss
+    // -- map.bsp<suffix> in the entry becomes <out_filename><suffix>
+    Materialised fetch(uint64_t key, const char *out_filename, bool with_hashes) {
+        std::filesystem::path found = entry(key);
+        std::error_code error;
+        if (!std::filesystem::is_directory(found, error)) { return Materialised::NONE; }
+        Materialised method = materialise(found / "map.bsp", out_filename);
+        for (auto &file : std::filesystem::directory_iterator(found, error)) {
+            std::string name = file.path().filename().string();
+            if (method == Materialised::NONE || name == "map.bsp" || name == "map.bsp.hashes") { continue; }
+            if (materialise(file.path(), out_filename + name.substr(7)) == Materialised::NONE) {
+                method = Materialised::NONE;
+            }
+        }
+        if (method != Materialised::NONE && with_hashes && !copy_hashes(found / "map.bsp.hashes", out_filename)) {
+            method = Materialised::NONE;
+        }
+        if (method == Materialised::NONE || error) {  // evicted mid-fetch, most likely
+            std::filesystem::remove(out_filename, error);
+            return Materialised::NONE;
+        }
+        std::filesystem::last_write_time(found, std::filesystem::file_time_type::clock::now(), error);
+        return method;
+    }
+
+    // a private directory to build an entry in; fill it w/ map.bsp, map.bsp.hashes & any map.bsp.*.bsp_lump, then insert() it
+    std::filesystem::path stage() {
+        std::filesystem::path staging = unique_path(".tmp-");
+        std::filesystem::create_directories(staging);
+        return staging;
+    }
+
+    // NOTE: if another worker inserted the same key first, its entry is kept & ours is discarded
+    void insert(uint64_t key, const std::filesystem::path &staging) {
+        std::error_code error;
+        // entries may be hardlinked into outputs, so they must never be written in place
+        for (auto &file : std::filesystem::directory_iterator(staging)) {
+            std::filesystem::permissions(file.path(), std::filesystem::perms::owner_write
+                | std::filesystem::perms::group_write | std::filesystem::perms::others_write,
+                std::filesystem::perm_options::remove, error);
+        }
+        std::filesystem::rename(staging, entry(key), error);
+        if (error) {
+            std::filesystem::remove_all(staging, error);
+        }
+        evict();
+    }
+
+    // drops the least recently used entries until the cache fits in max_bytes_
+    // -- & any staging directories left behind by crashed workers
+    void evict() {
+        struct Entry {
+            std::filesystem::path             path;
+            std::filesystem::file_time_type   last_used;
+            uint64_t                          size;
+        };
+        std::vector<Entry> entries;
+        uint64_t total = 0;
+        std::error_code error;
+        auto stale = std::filesystem::file_time_type::clock::now() - std::chrono::hours(1);
+        for (auto &dir : std::filesystem::directory_iterator(dir_, error)) {
+            std::string name = dir.path().filename().string();
+            auto last_used = std::filesystem::last_write_time(dir.path(), error);
+            if (error) { continue; }
+            if (name[0] == '.') {
+                if (last_used < stale) { std::filesystem::remove_all(dir.path(), error); }
+                continue;
+            }
+            uint64_t size = 0;
+            for (auto &file : std::filesystem::directory_iterator(dir.path(), error)) {
+                size += file.file_size(error);
+            }
+            entries.push_back({dir.path(), last_used, size});
+            total += size;
+        }
+        std::sort(entries.begin(), entries.end(), [](auto &a, auto &b) { return a.last_used < b.last_used; });
+        for (Entry &victim : entries) {
+            if (total <= max_bytes_) { break; }
+            // rename first, so no reader sees a half deleted entry
+            std::filesystem::path doomed = unique_path(".evict-");
+            std::filesystem::rename(victim.path, doomed, error);
+            if (!error) {
+                std::filesystem::remove_all(doomed, error);
+            }
+            total -= victim.size;
+        }
+    }
+
+    static const char *name(Materialised method) {
+        switch (method) {
+            case Materialised::REFLINK:   return "reflink";
+            case Materialised::HARDLINK:  return "hardlink";
+            case Materialised::COPY:      return "copy";
+            default:                      return "none";
+        }
+    }
+
+  private:
+    std::filesystem::path unique_path(const char *prefix) const {
+        static std::atomic<uint64_t> counter = 0;
+        uint64_t salt[3] = {
+            static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()),
+            std::random_device{}(),  // other processes share the cache too
+            counter++};
+        char hex[17];
+        hash::to_hex(hash::hash64(salt, sizeof(salt)), hex);
+        return dir_ / (std::string(prefix) + hex);
+    }
+
+    // the sidecar names the file it was written for, so it's rewritten rather than linked
+    static bool copy_hashes(const std::filesystem::path &from, const char *out_filename) {
+        std::ifstream in(from);
+        std::string line;
+        if (!std::getline(in, line) || line.rfind("file ", 0) != 0 || line.size() < 21) { return false; }
+        std::string hashes = line.substr(0, 21) + " " + out_filename + "\n";
+        while (std::getline(in, line)) { hashes += line + "\n"; }
+        std::ofstream out(std::string(out_filename) + ".hashes", std::ios::trunc);
+        out << hashes;
+        return static_cast<bool>(out);
+    }
+
+    // cheapest first: a copy-on-write clone, then a hardlink (same filesystem only), then a full copy
+    static Materialised materialise(const std::filesystem::path &from, const std::filesystem::path &to) {
+        std::error_code error;
+        std::filesystem::remove(to, error);  // never write through an existing hardlink
+#ifdef __linux__
+        int source = open(from.c_str(), O_RDONLY);
+        if (source != -1) {
+            int target = open(to.c_str(), O_CREAT | O_EXCL | O_WRONLY, 00666);
+            bool cloned = target != -1 && ioctl(target, FICLONE, source) == 0;
+            if (target != -1) { close(target); }
+            close(source);
+            if (cloned) { return Materialised::REFLINK; }
+            std::filesystem::remove(to, error);
+        }
+#endif
+        std::filesystem::create_hard_link(from, to, error);
+        if (!error) { return Materialised::HARDLINK; }
+        error.clear();
+        std::filesystem::copy_file(from, to, error);
+        if (!error) {  // a private copy, so it can be writable again
+            std::filesystem::permissions(to, std::filesystem::perms::owner_write, std::filesystem::perm_options::add, error);
+            return Materialised::COPY;
+        }
+        return Materialised::NONE;
+    }
+};
@@ -0,0 +1,459 @@
+// where converted lumps go on their way to disk
+// -- MMAP: lumps are written straight into a shared mapping of the whole (over-reserved) file
+//    the kernel writes the dirty pages back whenever it likes, mostly during set_size_and_close
+// -- PWRITE: each lump is written into its own buffer, then handed to a pool of writer threads
+// -- URING: each lump is written into its own buffer & submitted to an io_uring as soon as it's done
+//    a reaper thread collects completions while later lumps are still being converted
+// -- MEMORY: the whole file is built in a caller's std::vector, for in process conversions
+// -- STREAM: written front to back to a pipe, socket or stdout, see OutputStream (not an OutputFile)
+// NOTE: URING falls back to PWRITE if the kernel (or a seccomp filter) won't set up a ring
+// -- & both fall back to MMAP on Windows
+// NOTE: a file that is never closed (e.g. the conversion threw or was cancelled) is removed, not left half written
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "memory_mapped_file.hpp"
+
+
+enum class IoBackend { MMAP, PWRITE, URING, MEMORY, STREAM };
+
+
+const char *io_backend_name(IoBackend backend) {
+    switch (backend) {
+        case IoBackend::MMAP:    return "mmap";
+        case IoBackend::PWRITE:  return "pwrite";
+        case IoBackend::URING:   return "uring";
+        case IoBackend::MEMORY:  return "memory";
+        case IoBackend::STREAM:  return "stream";
+        default:                 return "unknown";
+    }
+}
+
+
+bool parse_io_backend(const char *name, IoBackend &backend) {
+    for (IoBackend option : {IoBackend::MMAP, IoBackend::PWRITE, IoBackend::URING}) {
+        if (strcmp(name, io_backend_name(option)) == 0) {
+            backend = option;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+class OutputFile { public:
+    IoBackend  backend_;  // may differ from the one asked for, see fallbacks above
+
+    // NOTE: retain keeps every buffer until close, so lumps can be read back (e.g. by tricoll::verify)
+    OutputFile(const char *filename, size_t reserved_size, IoBackend backend, unsigned num_writers = 2, bool retain = false)
+        : backend_(backend), filename_(filename), reserved_size_(reserved_size), retain_(retain) {
+#ifdef _WIN32
+        backend_ = IoBackend::MMAP;
+#endif
+        if (backend_ == IoBackend::MMAP) {
+            mapping_.open_new(filename, reserved_size);
+            return;
+        }
+#ifndef _WIN32
+        fd_ = open(filename, O_CREAT | O_TRUNC | O_WRONLY, 00666);
+        if (fd_ == -1) {
+            throw std::runtime_error("Failed opening file: "s + filename + " (" + std::to_string(errno) + ")");
+        }
+#endif
+#ifdef __linux__
+        if (backend_ == IoBackend::URING && setup_ring()) {
+            workers_.emplace_back([this]() { reap(); });
+            return;
+        }
+#endif
+        backend_ = IoBackend::PWRITE;
+        for (unsigned i = 0; i < std::max(1u, num_writers); i++) {
+            workers_.emplace_back([this]() { write_queued(); });
+        }
+    }
+
+    OutputFile(std::vector<char> &memory, size_t reserved_size)
+        : backend_(IoBackend::MEMORY), filename_("<memory>"), reserved_size_(reserved_size), retain_(true), memory_(&memory) {
+        memory.resize(reserved_size);
+    }
+
+    ~OutputFile() {
+        stop();
+        close_fd();
+        if (!closed_ && backend_ != IoBackend::MEMORY) {
+            mapping_.close();
+            ::remove(filename_.c_str());
+        }
+    }
+
+    // marks never written bytes (MMAP only, the other backends leave holes of 0)
+    void fill(uint8_t filler) {
+        if (backend_ == IoBackend::MMAP) { mapping_.fill(filler); }
+        if (backend_ == IoBackend::MEMORY) { memset(memory_->data(), filler, memory_->size()); }
+    }
+
+    // the bytes [offset, offset + length) of the file, to be filled in & then passed to write(key)
+    // -- key names the buffer & must be unique within the file (e.g. a lump index); not the offset,
+    //    since an empty lump starts where the next one does
+    // -- safe to call from many threads, for ranges that don't overlap
+    char *buffer(size_t key, size_t offset, size_t length) {
+        if (backend_ == IoBackend::MMAP || backend_ == IoBackend::MEMORY) {
+            if (offset + length > reserved_size_) {
+                throw std::runtime_error("Converted map is larger than the space reserved for it");
+            }
+            return backend_ == IoBackend::MMAP ? mapping_.rawdata(offset) : memory_->data() + offset;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto [found, added] = buffers_.try_emplace(key);
+        if (!added) { throw std::logic_error("OutputFile buffer key reused: " + std::to_string(key)); }
+        Buffer &buffer = found->second;
+        buffer.data = std::make_unique<char[]>(length);
+        buffer.offset = offset;
+        buffer.length = length;
+        return buffer.data.get();
+    }
+
+    template <typename T>
+    T *buffer(size_t key, size_t offset) { return reinterpret_cast<T*>(buffer(key, offset, sizeof(T))); }
+
+    // queues the buffer named key to be written; returns before it is
+    void write(size_t key) {
+        if (backend_ == IoBackend::MMAP || backend_ == IoBackend::MEMORY) { return; }
+        std::unique_lock<std::mutex> lock(mutex_);
+#ifdef __linux__
+        if (backend_ == IoBackend::URING) {
+            submit(key, lock);
+            return;
+        }
+#endif
+        queue_.push_back(key);
+        wake_.notify_all();
+    }
+
+    // waits for every queued write, then sets the file size
+    void close(size_t size) {
+        if (backend_ == IoBackend::MMAP) {
+            mapping_.set_size_and_close(size);
+            closed_ = true;
+            return;
+        }
+        if (backend_ == IoBackend::MEMORY) {
+            memory_->resize(size);
+            closed_ = true;
+            return;
+        }
+        stop();
+        if (error_ != 0) {
+            throw std::runtime_error("Failed writing file: " + filename_ + " (" + std::to_string(error_) + ")");
+        }
+#ifndef _WIN32
+        if (ftruncate(fd_, size) == -1) {
+            throw std::runtime_error("Failed ftruncating file: " + filename_ + " (" + std::to_string(errno) + ")");
+        }
+#endif
+        close_fd();
+        closed_ = true;
+    }
+
+  private:
+    struct Buffer {
+        std::unique_ptr<char[]>  data;
+        size_t                   offset = 0;  // in the file
+        size_t                   length = 0;
+        size_t                   unwritten_chunks = 0;  // URING only
+    };
+
+    std::string                  filename_;
+    size_t                       reserved_size_;
+    bool                         retain_;
+    bool                         closed_ = false;  // & complete
+    memory_mapped_file           mapping_;  // MMAP only
+    std::vector<char>           *memory_ = nullptr;  // MEMORY only
+    int                          fd_ = -1;
+    std::mutex                   mutex_;
+    std::condition_variable      wake_;
+    std::map<size_t, Buffer>     buffers_;  // by key; nodes don't move, so data stays put
+    std::deque<size_t>           queue_;  // keys, PWRITE only
+    bool                         stopping_ = false;
+    int                          error_ = 0;  // first errno
+    std::vector<std::thread>     workers_;
+
+    // waits for the workers (& so every write) to finish
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread &worker : workers_) { worker.join(); }
+        workers_.clear();
+#ifdef __linux__
+        if (ring_fd_ != -1) {
+            munmap(ring_, ring_size_);
+            munmap(sqes_, sqes_size_);
+            ::close(ring_fd_);
+            ring_fd_ = -1;
+        }
+#endif
+    }
+
+    void close_fd() {
+#ifndef _WIN32
+        if (fd_ != -1) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+#endif
+    }
+
+    // NOTE: called w/ mutex_ unlocked
+    void pwrite_all(const char *data, size_t length, size_t offset) {
+#ifndef _WIN32
+        while (length > 0) {
+            ssize_t written = pwrite(fd_, data, length, static_cast<off_t>(offset));
+            if (written == -1 && errno == EINTR) { continue; }
+            if (written <= 0) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (error_ == 0) { error_ = written == -1 ? errno : EIO; }
+                return;
+            }
+            data += written;
+            offset += written;
+            length -= written;
+        }
+#endif
+    }
+
+    void written(size_t key) {  // w/ mutex_ locked
+        if (!retain_) { buffers_.erase(key); }
+    }
+
+    // PWRITE worker: drains queue_ until stop()
+    void write_queued() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            wake_.wait(lock, [&]() { return !queue_.empty() || stopping_; });
+            if (queue_.empty()) { return; }
+            size_t key = queue_.front();
+            queue_.pop_front();
+            Buffer &buffer = buffers_.at(key);
+            lock.unlock();
+            pwrite_all(buffer.data.get(), buffer.length, buffer.offset);
+            lock.lock();
+            written(key);
+        }
+    }
+
+#ifdef __linux__
+    // a raw io_uring, w/o liburing: 1 shared mapping for the SQ & CQ rings (IORING_FEAT_SINGLE_MMAP) + the SQE array
+    static constexpr unsigned RING_ENTRIES = 64;
+    static constexpr size_t   MAX_CHUNK = 1u << 30;  // IORING_OP_WRITE lengths are 32-bit
+
+    struct Chunk {
+        size_t  buffer_key;  // into buffers_
+        size_t  file_offset;
+        char   *data;
+        size_t  length;
+    };
+
+    int               ring_fd_ = -1;
+    void             *ring_ = nullptr;
+    size_t            ring_size_ = 0;
+    io_uring_sqe     *sqes_ = nullptr;
+    size_t            sqes_size_ = 0;
+    unsigned         *sq_head_, *sq_tail_, *sq_mask_, *sq_array_;
+    unsigned         *cq_head_, *cq_tail_, *cq_mask_;
+    io_uring_cqe     *cqes_;
+    unsigned          in_flight_ = 0;
+    std::deque<Chunk> chunks_;  // user_data points at these; deque push_back never moves elements
+    std::deque<Chunk*> free_chunks_;
+
+    bool setup_ring() {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        int fd = static_cast<int>(syscall(__NR_io_uring_setup, RING_ENTRIES, &params));
+        if (fd == -1) { return false; }
+        if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {  // pre 5.4 kernel, not worth the extra mapping
+            ::close(fd);
+            return false;
+        }
+        size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        ring_size_ = std::max(sq_size, cq_size);
+        ring_ = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        void *sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (ring_ == MAP_FAILED || sqes == MAP_FAILED) {
+            if (ring_ != MAP_FAILED) { munmap(ring_, ring_size_); }
+            if (sqes != MAP_FAILED) { munmap(sqes, sqes_size_); }
+            ::close(fd);
+            return false;
+        }
+        char *ring = static_cast<char*>(ring_);
+        sqes_     = static_cast<io_uring_sqe*>(sqes);
+        sq_head_  = reinterpret_cast<unsigned*>(ring + params.sq_off.head);
+        sq_tail_  = reinterpret_cast<unsigned*>(ring + params.sq_off.tail);
+        sq_mask_  = reinterpret_cast<unsigned*>(ring + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(ring + params.sq_off.array);
+        cq_head_  = reinterpret_cast<unsigned*>(ring + params.cq_off.head);
+        cq_tail_  = reinterpret_cast<unsigned*>(ring + params.cq_off.tail);
+        cq_mask_  = reinterpret_cast<unsigned*>(ring + params.cq_off.ring_mask);
+        cqes_     = reinterpret_cast<io_uring_cqe*>(ring + params.cq_off.cqes);
+        ring_fd_  = fd;
+        return true;
+    }
+
+    // 1 SQE per chunk; waits for the reaper if the ring is full
+    void submit(size_t key, std::unique_lock<std::mutex> &lock) {
+        Buffer &buffer = buffers_.at(key);
+        buffer.unwritten_chunks = (buffer.length + MAX_CHUNK - 1) / MAX_CHUNK;
+        if (buffer.length == 0) {
+            written(key);
+            return;
+        }
+        for (size_t start = 0; start < buffer.length; start += MAX_CHUNK) {
+            wake_.wait(lock, [&]() { return in_flight_ < RING_ENTRIES; });
+            Chunk chunk = {key, buffer.offset + start, buffer.data.get() + start, std::min(MAX_CHUNK, buffer.length - start)};
+            Chunk *slot;
+            if (free_chunks_.empty()) {
+                slot = &chunks_.emplace_back(chunk);
+            } else {
+                slot = free_chunks_.front();
+                free_chunks_.pop_front();
+                *slot = chunk;
+            }
+            unsigned tail = *sq_tail_;
+            unsigned index = tail & *sq_mask_;
+            io_uring_sqe &sqe = sqes_[index];
+            memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode    = IORING_OP_WRITE;
+            sqe.fd        = fd_;
+            sqe.addr      = reinterpret_cast<uint64_t>(slot->data);
+            sqe.len       = static_cast<uint32_t>(slot->length);
+            sqe.off       = slot->file_offset;
+            sqe.user_data = reinterpret_cast<uint64_t>(slot);
+            sq_array_[index] = index;
+            __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+            in_flight_++;
+            while (syscall(__NR_io_uring_enter, ring_fd_, 1, 0, 0, nullptr, 0) == -1) {
+                if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                    // NOTE: the SQE stays in the ring, but nothing will wait for it; close() reports the error
+                    if (error_ == 0) { error_ = errno; }
+                    in_flight_--;
+                    break;
+                }
+            }
+        }
+        wake_.notify_all();
+    }
+
+    // URING worker: collects completions until stop() & nothing is in flight
+    void reap() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            wake_.wait(lock, [&]() { return in_flight_ > 0 || stopping_; });
+            if (in_flight_ == 0) { return; }
+            lock.unlock();
+            // NOTE: only this thread touches the CQ, submit() only the SQ; the kernel is fine w/ both at once
+            int waited = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+            if (waited == -1 && errno != EINTR) {
+                lock.lock();
+                if (error_ == 0) { error_ = errno; }
+                abandon_in_flight();
+                continue;
+            }
+            unsigned head = *cq_head_;
+            unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+            std::vector<std::pair<Chunk*, int>> completed;
+            for (; head != tail; head++) {
+                io_uring_cqe &cqe = cqes_[head & *cq_mask_];
+                completed.push_back({reinterpret_cast<Chunk*>(cqe.user_data), cqe.res});
+            }
+            __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+            for (auto &[chunk, result] : completed) {
+                if (result >= 0 && static_cast<size_t>(result) < chunk->length) {  // short write, finish it here
+                    pwrite_all(chunk->data + result, chunk->length - result, chunk->file_offset + result);
+                }
+            }
+            lock.lock();
+            for (auto &[chunk, result] : completed) {
+                if (result < 0 && error_ == 0) { error_ = -result; }
+                Buffer &buffer = buffers_.at(chunk->buffer_key);
+                if (--buffer.unwritten_chunks == 0) { written(chunk->buffer_key); }
+                free_chunks_.push_back(chunk);
+                in_flight_--;
+            }
+            wake_.notify_all();
+        }
+    }
+
+    // the ring is broken, give up on what it holds; close() reports error_
+    void abandon_in_flight() {  // w/ mutex_ locked
+        in_flight_ = 0;
+        wake_.notify_all();
+    }
+#endif
+};
+
+
+// a sink that only takes bytes in order: never seeks, maps or truncates, so pipes, sockets & stdout work
+// -- the caller owns fd; nothing is buffered here
+class OutputStream { public:
+    size_t  offset_ = 0;  // bytes written so far
+
+    OutputStream(int fd) : fd_(fd) {}
+
+    void write(const char *data, size_t length) {
+        while (length > 0) {
+#ifdef _WIN32
+            int written = _write(fd_, data, static_cast<unsigned>(std::min(length, size_t(1) << 30)));
+#else
+            ssize_t written = ::write(fd_, data, length);
+            if (written == -1 && errno == EINTR) { continue; }
+#endif
+            if (written <= 0) {
+                throw std::runtime_error("Failed writing output stream (" + std::to_string(errno) + ")");
+            }
+            data += written;
+            length -= static_cast<size_t>(written);
+            offset_ += static_cast<size_t>(written);
+        }
+    }
+
+    // nulls up to offset
+    void pad(size_t offset) {
+        static const char zeros[4096] = {};
+        while (offset_ < offset) {
+            write(zeros, std::min(offset - offset_, sizeof(zeros)));
+        }
+    }
+
+  private:
+    int  fd_;
+};
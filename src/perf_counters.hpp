@@ -0,0 +1,153 @@
+// hardware performance counters per conversion stage, via perf_event_open (Linux only)
+// -- cycles, instructions, cache misses, branch misses & page faults of the calling thread, user space only
+// -- each counter is opened on its own, so a VM w/o a PMU still reports page faults (a software counter)
+// NOTE: low IPC w/ many cache misses per 1k instructions points at a memory bound stage
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+namespace perf_counters {
+    enum Counter { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, PAGE_FAULTS, NUM_COUNTERS };
+
+    const char *NAMES[NUM_COUNTERS] = {"cycles", "instructions", "cache misses", "branch misses", "page faults"};
+
+    struct Counts {
+        uint64_t  values[NUM_COUNTERS] = {};
+        bool      available[NUM_COUNTERS] = {};
+        double    milliseconds = 0;
+        uint32_t  runs = 0;  // stages that run more than once (e.g. writeLump) are summed
+
+        void add(const Counts &other) {
+            for (int i = 0; i < NUM_COUNTERS; i++) {
+                values[i] += other.values[i];
+                available[i] = available[i] || other.available[i];
+            }
+            milliseconds += other.milliseconds;
+            runs += other.runs;
+        }
+    };
+
+
+    // every stage measured during 1 conversion, in the order they first finished
+    struct Report {
+        std::mutex                                     mutex;
+        std::vector<std::pair<std::string, Counts>>    stages;
+        std::string                                    unavailable;  // why any counter couldn't be opened
+
+        void add(const char *name, const Counts &counts) {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto &[stage, total] : stages) {
+                if (stage == name) {
+                    total.add(counts);
+                    return;
+                }
+            }
+            stages.push_back({name, counts});
+        }
+
+        void print(FILE *out = stdout) {
+            fprintf(out, "%-20s %9s %14s %14s %6s %13s %13s %11s\n", "Stage", "ms", NAMES[CYCLES], NAMES[INSTRUCTIONS], "IPC",
+                NAMES[CACHE_MISSES], NAMES[BRANCH_MISSES], NAMES[PAGE_FAULTS]);
+            for (auto &[stage, counts] : stages) {
+                char cells[NUM_COUNTERS][32];
+                for (int i = 0; i < NUM_COUNTERS; i++) {
+                    if (counts.available[i]) {
+                        snprintf(cells[i], 32, "%llu", static_cast<unsigned long long>(counts.values[i]));
+                    } else {
+                        snprintf(cells[i], 32, "n/a");
+                    }
+                }
+                char ipc[16] = "n/a";
+                if (counts.available[CYCLES] && counts.available[INSTRUCTIONS] && counts.values[CYCLES] != 0) {
+                    snprintf(ipc, 16, "%.2f", static_cast<double>(counts.values[INSTRUCTIONS]) / counts.values[CYCLES]);
+                }
+                std::string name = counts.runs > 1 ? stage + " x" + std::to_string(counts.runs) : stage;
+                fprintf(out, "%-20s %9.3f %14s %14s %6s %13s %13s %11s\n", name.c_str(), counts.milliseconds,
+                    cells[CYCLES], cells[INSTRUCTIONS], ipc, cells[CACHE_MISSES], cells[BRANCH_MISSES], cells[PAGE_FAULTS]);
+            }
+            if (!unavailable.empty()) { fprintf(out, "  (%s)\n", unavailable.c_str()); }
+        }
+    };
+
+
+    // counts the calling thread's events while in scope, then adds them to report
+    // -- does nothing if report is null, so stages can always declare one
+    class Scope { public:
+        Scope(const char *name, Report *report) : name_(name), report_(report) {
+            if (report_ == nullptr) { return; }
+#ifdef __linux__
+            const uint32_t types[NUM_COUNTERS] = {
+                PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE};
+            const uint64_t configs[NUM_COUNTERS] = {
+                PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+                PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_SW_PAGE_FAULTS};
+            for (int i = 0; i < NUM_COUNTERS; i++) {
+                perf_event_attr attr;
+                memset(&attr, 0, sizeof(attr));
+                attr.size           = sizeof(attr);
+                attr.type           = types[i];
+                attr.config         = configs[i];
+                attr.disabled       = 1;
+                attr.exclude_kernel = 1;  // allowed at perf_event_paranoid 2, the usual default
+                attr.exclude_hv     = 1;
+                fds_[i] = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+                if (fds_[i] == -1) {
+                    std::lock_guard<std::mutex> lock(report_->mutex);
+                    if (report_->unavailable.empty()) {
+                        report_->unavailable = std::string(NAMES[i]) + " unavailable: " + strerror(errno);
+                    }
+                }
+            }
+            for (int fd : fds_) {
+                if (fd != -1) {
+                    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+                }
+            }
+#else
+            report_->unavailable = "perf counters are only available on Linux";
+#endif
+            start_ = std::chrono::steady_clock::now();
+        }
+
+        ~Scope() {
+            if (report_ == nullptr) { return; }
+            Counts counts;
+            counts.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+            counts.runs = 1;
+#ifdef __linux__
+            for (int i = 0; i < NUM_COUNTERS; i++) {
+                if (fds_[i] == -1) { continue; }
+                ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+                uint64_t value;
+                if (read(fds_[i], &value, sizeof(value)) == sizeof(value)) {
+                    counts.values[i] = value;
+                    counts.available[i] = true;
+                }
+                close(fds_[i]);
+            }
+#endif
+            report_->add(name_, counts);
+        }
+
+      private:
+        const char                             *name_;
+        Report                                 *report_;
+        int                                     fds_[NUM_COUNTERS] = {-1, -1, -1, -1, -1};
+        std::chrono::steady_clock::time_point   start_;
+    };
+};
@@ -0,0 +1,84 @@
+// memoised prop bounds, keyed by (model, angles, scale)
+// -- maps place the same fences, crates & rocks at the same angles hundreds of times
+// -- each instance then only adds its origin to the cached local space bounds
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+#include <memory_resource>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "bounds.hpp"
+#include "models.hpp"
+
+
+struct PropTransform {
+    MinMax        bounds;  // relative to the prop origin
+    uint32_t      first_footprint;  // into PropTransformCache::footprints_
+    uint32_t      num_footprints;
+    bool          yaw_only;
+    YawTransform  yaw;  // only if yaw_only
+};
+
+
+class PropTransformCache { public:
+    // NOTE: compares float bits, so -0 & 0 are different keys; a miss costs nothing but time
+    struct Key {
+        uint32_t  model_name;
+        uint32_t  angles[3];
+        uint32_t  scale;
+
+        bool operator==(const Key &other) const { return memcmp(this, &other, sizeof(Key)) == 0; }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key &key) const {
+            uint64_t hash = 0xCBF29CE484222325ull;  // FNV-1a, 32 bits at a time
+            for (uint32_t word : {key.model_name, key.angles[0], key.angles[1], key.angles[2], key.scale}) {
+                hash = (hash ^ word) * 0x100000001B3ull;
+            }
+            return static_cast<size_t>(hash ^ (hash >> 32));
+        }
+    };
+
+    std::pmr::unordered_map<Key, PropTransform, KeyHash>  transforms_;
+    std::pmr::vector<MinMax>                              footprints_;
+    uint32_t                                              hits_   = 0;
+    uint32_t                                              misses_ = 0;
+
+    PropTransformCache(std::pmr::memory_resource *arena) : transforms_(arena), footprints_(arena) {}
+
+    // boxes is the model's per-tri AABB footprint
+    const PropTransform &get(uint16_t model_name, Vector3 angles, float scale, const mstudiopertrihdr_t &perTri, std::span<const LocalBox> boxes) {
+        Key key = {.model_name = model_name, .angles = {}, .scale = 0};
+        memcpy(key.angles, &angles, sizeof(key.angles));
+        memcpy(&key.scale, &scale, sizeof(key.scale));
+        auto cached = transforms_.find(key);
+        if (cached != transforms_.end()) {
+            hits_++;
+            return cached->second;
+        }
+        misses_++;
+
+        __m128 scale_ps = _mm_set1_ps(scale);
+        PropTransform transform;
+        transform.bounds = minmax_from_local_bounds(perTri.bbmin, perTri.bbmax, angles, scale_ps);
+        transform.first_footprint = static_cast<uint32_t>(footprints_.size());
+        transform.num_footprints = static_cast<uint32_t>(boxes.size());
+        for (const LocalBox &box : boxes) {
+            footprints_.push_back(minmax_from_local_bounds(box.mins, box.maxs, angles, scale_ps));
+        }
+        transform.yaw_only = is_yaw_only(angles);
+        if (transform.yaw_only) {
+            transform.yaw = yaw_transform(perTri.bbmin, perTri.bbmax, angles.y, scale);
+        }
+        return transforms_.emplace(key, transform).first->second;
+    }
+
+    std::span<const MinMax> footprint(const PropTransform &transform) const {
+        return {footprints_.data() + transform.first_footprint, transform.num_footprints};
+    }
+};
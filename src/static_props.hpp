@@ -0,0 +1,92 @@
+// GAME_LUMP.sprp v12 (Titanfall) -> v13 (Titanfall 2) StaticProp re-layout
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <immintrin.h>
+
+#include "titanfall.hpp"
+#include "titanfall2.hpp"
+
+
+titanfall2::StaticProp convert_static_prop(const titanfall::StaticProp &r1Prop) {
+    titanfall2::StaticProp r2Prop = {
+        .origin                 = r1Prop.origin,
+        .angles                 = r1Prop.angles,
+        .scale                  = r1Prop.scale,
+        .model_name             = r1Prop.model_name,
+        .solid_type             = r1Prop.solid_type,
+        .flags                  = r1Prop.flags,
+        .skin                   = r1Prop.skin,
+        .cubemap                = r1Prop.cubemap,
+        .forced_fade_scale      = r1Prop.forced_fade_scale,
+        .lighting_origin        = r1Prop.lighting_origin,
+        .diffuse_modulation_r   = r1Prop.diffuse_modulation_r,
+        .diffuse_modulation_g   = r1Prop.diffuse_modulation_g,
+        .diffuse_modulation_b   = r1Prop.diffuse_modulation_b,
+        .diffuse_modulation_a   = r1Prop.diffuse_modulation_a,
+        .collision_flags_add    = r1Prop.collision_flags_add,
+        .collision_flags_remove = r1Prop.collision_flags_remove};
+    return r2Prop;
+}
+
+
+// NOTE: in & out don't need to be aligned
+void convert_static_props_scalar(const char *in, char *out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        titanfall::StaticProp r1Prop;
+        memcpy(&r1Prop, &in[i * sizeof(titanfall::StaticProp)], sizeof(titanfall::StaticProp));
+        titanfall2::StaticProp r2Prop = convert_static_prop(r1Prop);
+        memcpy(&out[i * sizeof(titanfall2::StaticProp)], &r2Prop, sizeof(titanfall2::StaticProp));
+    }
+}
+
+
+#ifdef __SSE2__
+// gathers each v13 prop from 6 unaligned 16 byte loads w/ dword shuffles
+// -- r1 dwords d0-d20 -> r2 dwords:
+// -- d0-d5 (origin, angles), d18 (scale), d6.lo|d7.hi (model_name, solid_type, flags), d8 (skin, cubemap),
+// -- d14 (forced_fade_scale), d11-d13 (lighting_origin), d16 (diffuse_modulation), d19-d20 (collision_flags)
+void convert_static_props_sse2(const char *in, char *out, size_t count) {
+    static_assert(sizeof(titanfall::StaticProp) == 0x54 && sizeof(titanfall2::StaticProp) == 0x40);
+    #define SHUFFLE_PS(a, b, imm) \
+        _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), imm))
+
+    for (size_t i = 0; i < count; i++) {
+        const char *r1 = &in[i * sizeof(titanfall::StaticProp)];
+        char       *r2 = &out[i * sizeof(titanfall2::StaticProp)];
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r1 + 0x00));  // d0-d3
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r1 + 0x10));  // d4-d7
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r1 + 0x20));  // d8-d11
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r1 + 0x30));  // d12-d15
+        __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r1 + 0x40));  // d16-d19
+        __m128i f = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r1 + 0x44));  // d17-d20
+
+        // words 4-7 of b: model_name, first_leaf, num_leaves, solid_type & flags -> lane 3: model_name, solid_type & flags
+        __m128i t = _mm_shufflehi_epi16(b, _MM_SHUFFLE(3, 0, 1, 0));
+        __m128i g = SHUFFLE_PS(e, t, _MM_SHUFFLE(3, 3, 2, 2));            // d18, d18, d6.lo|d7.hi, ...
+        __m128i out1 = SHUFFLE_PS(t, g, _MM_SHUFFLE(2, 0, 1, 0));         // d4, d5, d18, d6.lo|d7.hi
+        __m128i h = SHUFFLE_PS(c, d, _MM_SHUFFLE(2, 0, 3, 0));            // d8, d11, d12, d14
+        __m128i out2 = _mm_shuffle_epi32(h, _MM_SHUFFLE(2, 1, 3, 0));     // d8, d14, d11, d12
+        __m128i j = SHUFFLE_PS(d, e, _MM_SHUFFLE(0, 0, 1, 1));            // d13, d13, d16, d16
+        __m128i out3 = SHUFFLE_PS(j, f, _MM_SHUFFLE(3, 2, 2, 0));         // d13, d16, d19, d20
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(r2 + 0x00), a);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(r2 + 0x10), out1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(r2 + 0x20), out2);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(r2 + 0x30), out3);
+    }
+
+    #undef SHUFFLE_PS
+}
+#endif
+
+
+// re-lays out a whole array of r1 props into r2 props in one pass
+void convert_static_props(const char *in, char *out, size_t count) {
+#ifdef __SSE2__
+    convert_static_props_sse2(in, out, count);
+#else
+    convert_static_props_scalar(in, out, count);
+#endif
+}
@@ -0,0 +1,92 @@
+// dependency graph of conversion tasks, run on a pool of worker threads
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+class TaskGraph { public:
+    typedef size_t TaskId;
+
+    struct Task {
+        std::string          name;
+        std::function<void()> run;
+        std::vector<TaskId>  dependents;
+        size_t               num_dependencies;
+    };
+
+    std::vector<Task> tasks_;
+
+    // NOTE: dependencies must already be in the graph, so it can't contain cycles
+    TaskId add(const char *name, std::function<void()> run, std::vector<TaskId> dependencies = {}) {
+        TaskId id = tasks_.size();
+        tasks_.push_back({name, run, {}, dependencies.size()});
+        for (TaskId dependency : dependencies) {
+            tasks_[dependency].dependents.push_back(id);
+        }
+        return id;
+    }
+
+    // runs every task once all of its dependencies have finished
+    // -- num_threads <= 1 runs every task on the calling thread, in the order they were added
+    // -- the first exception thrown by a task stops any more tasks starting & is rethrown here
+    void run(unsigned num_threads) {
+        std::vector<size_t> waiting_on(tasks_.size());
+        std::deque<TaskId> ready;
+        for (TaskId id = 0; id < tasks_.size(); id++) {
+            waiting_on[id] = tasks_[id].num_dependencies;
+            if (waiting_on[id] == 0) { ready.push_back(id); }
+        }
+
+        if (num_threads <= 1) {
+            // tasks are added after their dependencies, so insertion order is a valid order
+            for (Task &task : tasks_) { task.run(); }
+            return;
+        }
+
+        std::mutex               mutex;
+        std::condition_variable  wake;
+        size_t                   num_finished = 0;
+        std::exception_ptr       error;
+
+        auto worker = [&]() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                wake.wait(lock, [&]() { return !ready.empty() || num_finished == tasks_.size() || error; });
+                if (ready.empty() || error) { return; }
+                TaskId id = ready.front();
+                ready.pop_front();
+                lock.unlock();
+                std::exception_ptr task_error;
+                try {
+                    tasks_[id].run();
+                } catch (...) {
+                    task_error = std::current_exception();
+                }
+                lock.lock();
+                if (task_error && !error) { error = task_error; }
+                num_finished++;
+                for (TaskId dependent : tasks_[id].dependents) {
+                    if (--waiting_on[dependent] == 0) { ready.push_back(dependent); }
+                }
+                wake.notify_all();
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < num_threads; i++) {
+            workers.emplace_back(worker);
+        }
+        for (std::thread &thread : workers) {
+            thread.join();
+        }
+        if (error) { std::rethrow_exception(error); }
+    }
+};
@@ -89,6 +89,20 @@ namespace titanfall {
     static_assert(offsetof(GridCell, num_geo_sets)  == 0x02);
 
 
+    struct Model {
+        Vector3   mins;
+        Vector3   maxs;
+        uint32_t  first_mesh;
+        uint32_t  num_meshes;
+    };
+
+    static_assert(sizeof(Model) == 0x20);
+    static_assert(offsetof(Model, mins)       == 0x00);
+    static_assert(offsetof(Model, maxs)       == 0x0C);
+    static_assert(offsetof(Model, first_mesh) == 0x18);
+    static_assert(offsetof(Model, num_meshes) == 0x1C);
+
+
     struct LightProbeRef {
         Vector3   origin;
         uint32_t  probe;
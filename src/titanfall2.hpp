@@ -29,6 +29,13 @@ namespace titanfall2 {
     static_assert(offsetof(LightProbeRef, unknown) == 0x10);
 
 
+    struct RealTimeLight {  // NOTE: contents unknown, we write nulls
+        uint8_t  unknown[9];
+    };
+
+    static_assert(sizeof(RealTimeLight) == 0x09);
+
+
     struct StaticProp {
         Vector3   origin;
         Vector3   angles;
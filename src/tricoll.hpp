@@ -1,26 +1,40 @@
 // for reading (r1) & writing (r2) TricollBevelIndices
+#pragma once
+
+#include <algorithm>
 #include <cstdint>
+#include <cstdio>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "titanfall.hpp"
 
 
 struct BitReader {
     uint64_t  buffer;
     uint64_t  bitsReadFromBuffer;
     uint32_t *fillBuffer;
+    uint32_t *endBuffer;  // reads past the end of the lump are 0
 
-    BitReader(uint32_t *startBuffer, uint64_t startBit) {
+    BitReader(uint32_t *startBuffer, uint32_t *endBuffer, uint64_t startBit) : endBuffer(endBuffer) {
         fillBuffer = &startBuffer[startBit / 32];
-        buffer = *fillBuffer++;
-        buffer |= (uint64_t)*fillBuffer++ << 32;
+        buffer = Fill();
+        buffer |= (uint64_t)Fill() << 32;
         buffer = buffer >> (startBit & 0x1F);
         bitsReadFromBuffer = startBit & 0x1F;
     }
 
+    uint32_t Fill() {
+        return fillBuffer < endBuffer ? *fillBuffer++ : 0;
+    }
+
     uint32_t Read10() {
         uint32_t res = buffer & 0x3FF;
         buffer = buffer >> 10;
         bitsReadFromBuffer += 10;
         if (bitsReadFromBuffer >= 0x20) {
-            buffer |= (uint64_t)*fillBuffer++ << (64 - bitsReadFromBuffer);
+            buffer |= (uint64_t)Fill() << (64 - bitsReadFromBuffer);
             bitsReadFromBuffer -= 32;
         }
         return res;
@@ -37,3 +51,177 @@ void write11Bit(uint32_t *writeBuffer, uint64_t offset, uint32_t data) {
     writeBuffer[intOffset] = (uint32_t)buffer;
     writeBuffer[intOffset + 1] = buffer >> 32;
 }
+
+
+// decoding & verifying TricollBevelIndices
+// -- r1 packs each index in 10 bits, r2 in 11 bits; starts are counted in indices, not bits
+// -- num_bevels == 15 starts an escape coded chain of {num_bevels, tricoll index} descriptors (2 indices each)
+// -- each followed by num_bevels indices, until the descriptor points back at its own TricollHeader
+namespace tricoll {
+    // 1 index, w/o reading past the end of words
+    template <unsigned BITS>
+    inline uint32_t read_bits(std::span<const uint32_t> words, uint64_t bit) {
+        uint64_t word = bit / 32;
+        uint64_t buffer = words[word];
+        if (word + 1 < words.size()) {
+            buffer |= static_cast<uint64_t>(words[word + 1]) << 32;
+        }
+        return static_cast<uint32_t>(buffer >> (bit & 0x1F)) & ((1u << BITS) - 1);
+    }
+
+    // NOTE: each index is extracted from its own 64-bit window, w/o the serial dependency of BitReader
+    // -- so the compiler can vectorise runs of plain (non-chained) indices
+    template <unsigned BITS>
+    inline void read_run(std::span<const uint32_t> words, uint64_t first, uint32_t count, uint32_t *out) {
+        if ((first + count) * BITS + 32 <= words.size() * 32) {  // fast path, every window in bounds
+            const uint32_t *data = words.data();
+            for (uint32_t i = 0; i < count; i++) {
+                uint64_t bit = (first + i) * BITS;
+                uint64_t buffer = data[bit / 32] | (static_cast<uint64_t>(data[bit / 32 + 1]) << 32);
+                out[i] = static_cast<uint32_t>(buffer >> (bit & 0x1F)) & ((1u << BITS) - 1);
+            }
+        } else {
+            for (uint32_t i = 0; i < count; i++) {
+                out[i] = read_bits<BITS>(words, (first + i) * BITS);
+            }
+        }
+    }
+
+    // appends the bevels of 1 triangle to out; escape descriptors are appended as 1 (20-bit) value
+    // -- num_indices is TricollHeader.num_bevel_indices, the length of the stream
+    // -- returns an error message, or "" if the stream is valid
+    template <unsigned BITS>
+    std::string decode_bevels(
+        std::span<const uint32_t>  words,
+        uint32_t                   num_indices,
+        uint32_t                   start,
+        uint32_t                   num_bevels,
+        uint32_t                   header_index,
+        uint32_t                   num_headers,
+        std::vector<uint32_t>     &out) {
+        if (static_cast<uint64_t>(num_indices) * BITS > words.size() * 32ull) {
+            return "num_bevel_indices is larger than the lump";
+        }
+        uint64_t cursor = start;
+        auto take = [&](uint32_t count) -> bool {
+            if (cursor + count > num_indices) { return false; }
+            size_t size = out.size();
+            out.resize(size + count);
+            read_run<BITS>(words, cursor, count, out.data() + size);
+            cursor += count;
+            return true;
+        };
+        if (num_bevels != 15) {
+            return take(num_bevels) ? "" : "bevels run past num_bevel_indices";
+        }
+        uint32_t index;
+        do {
+            uint32_t descriptor[2];
+            if (cursor + 2 > num_indices) { return "escape descriptor runs past num_bevel_indices"; }
+            read_run<BITS>(words, cursor, 2, descriptor);
+            cursor += 2;
+            uint32_t data = descriptor[0] | (descriptor[1] << BITS);
+            out.push_back(data);
+            num_bevels = data & 0x7F;
+            index = data >> 7;
+            if (index >= num_headers) {
+                return "escape chain tricoll index " + std::to_string(index) + " out of range";
+            }
+            if (!take(num_bevels)) { return "escape chain runs past num_bevel_indices"; }
+        } while (index != header_index && num_bevels);
+        return "";
+    }
+
+
+    struct VerifyReport {
+        uint32_t                  num_headers   = 0;
+        uint32_t                  num_triangles = 0;
+        uint64_t                  num_indices   = 0;  // decoded from each side
+        uint32_t                  num_errors    = 0;
+        std::vector<std::string>  errors;  // first few only
+
+        void error(uint32_t header, uint32_t triangle, const std::string &reason) {
+            if (errors.size() < 16) {
+                errors.push_back("TricollHeader " + std::to_string(header) + ", triangle " + std::to_string(triangle) + ": " + reason);
+            }
+            num_errors++;
+        }
+
+        void print(FILE *out = stdout) {
+            fprintf(out, "Verified %u TricollHeaders, %u triangles, %llu bevel indices: %u errors\n",
+                num_headers, num_triangles, static_cast<unsigned long long>(num_indices), num_errors);
+            for (auto &message : errors) { fprintf(out, "  %s\n", message.c_str()); }
+        }
+    };
+
+
+    // decodes the r1 & r2 bevels of every triangle & checks they match, value by value
+    // -- r1 streams that fail to decode are reported too, the converter copies their mistakes
+    VerifyReport verify(
+        std::span<const titanfall::TricollHeader>  r1_headers,
+        std::span<const uint32_t>                  r1_indices,
+        std::span<const titanfall::TricollHeader>  r2_headers,
+        std::span<const uint32_t>                  r2_indices,
+        std::span<const uint32_t>                  tris,
+        std::span<const uint16_t>                  starts) {
+        VerifyReport report;
+        if (r1_headers.size() != r2_headers.size()) {
+            report.error(0, 0, "TricollHeader count differs");
+            return report;
+        }
+        uint32_t num_headers = static_cast<uint32_t>(r1_headers.size());
+        std::vector<uint32_t> r1, r2;  // reused for each triangle
+        for (uint32_t i = 0; i < num_headers; i++) {
+            const titanfall::TricollHeader &r1_header = r1_headers[i];
+            const titanfall::TricollHeader &r2_header = r2_headers[i];
+            report.num_headers++;
+            if (r1_header.num_bevel_indices != r2_header.num_bevel_indices
+             || r1_header.num_triangles != r2_header.num_triangles
+             || r1_header.first_triangle != r2_header.first_triangle) {
+                report.error(i, 0, "header fields differ");
+                continue;
+            }
+            if (r1_header.num_bevel_indices == 0) { continue; }
+            if (r1_header.first_triangle > tris.size() || r1_header.num_triangles > tris.size() - r1_header.first_triangle
+             || r1_header.first_triangle + r1_header.num_triangles > starts.size()) {
+                report.error(i, 0, "triangles are outside the lump");
+                continue;
+            }
+            if (r1_header.first_bevel_index > r1_indices.size() || r2_header.first_bevel_index > r2_indices.size()) {
+                report.error(i, 0, "first_bevel_index is outside the lump");
+                continue;
+            }
+            auto r1_words = r1_indices.subspan(r1_header.first_bevel_index);
+            // r2 streams are packed end to end, each rounded up to whole words
+            size_t r2_length = (r2_header.num_bevel_indices * 11u + 31) / 32;
+            auto r2_words = r2_indices.subspan(r2_header.first_bevel_index,
+                std::min(r2_length, r2_indices.size() - r2_header.first_bevel_index));
+
+            for (uint32_t k = 0; k < r1_header.num_triangles; k++) {
+                uint32_t num_bevels = (tris[r1_header.first_triangle + k] >> 24) & 0xF;
+                uint16_t start = starts[r1_header.first_triangle + k];
+                report.num_triangles++;
+                r1.clear();
+                r2.clear();
+                std::string r1_error = decode_bevels<10>(r1_words, r1_header.num_bevel_indices, start, num_bevels, i, num_headers, r1);
+                if (!r1_error.empty()) {
+                    report.error(i, k, "r1: " + r1_error);
+                    continue;
+                }
+                std::string r2_error = decode_bevels<11>(r2_words, r2_header.num_bevel_indices, start, num_bevels, i, num_headers, r2);
+                if (!r2_error.empty()) {
+                    report.error(i, k, "r2: " + r2_error);
+                    continue;
+                }
+                report.num_indices += r1.size();
+                if (r1 != r2) {
+                    size_t j = 0;
+                    while (j < r1.size() && j < r2.size() && r1[j] == r2[j]) { j++; }
+                    report.error(i, k, "bevel " + std::to_string(j) + " differs (r1 " + (j < r1.size() ? std::to_string(r1[j]) : "end")
+                        + ", r2 " + (j < r2.size() ? std::to_string(r2[j]) : "end") + ")");
+                }
+            }
+        }
+        return report;
+    }
+};
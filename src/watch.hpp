@@ -0,0 +1,244 @@
+// --watch: reconverts maps as they, or the models they use, change (Linux only, via inotify)
+// -- every <in_dir>/*.bsp is converted to <out_dir>/*.bsp; models are watched recursively under model_dir
+// -- bursts of writes are debounced, then the affected maps are converted on a background thread
+// -- model metadata stays warm in a ModelCache between conversions
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "bsp.hpp"
+#include "convert.hpp"
+#include "game_lump.hpp"
+#include "models.hpp"
+
+
+class Watcher { public:
+    typedef std::chrono::steady_clock Clock;
+
+    std::filesystem::path  in_dir_;
+    std::filesystem::path  out_dir_;
+    ConvertOptions         options_;
+    ModelCache             models_;
+    std::chrono::milliseconds  debounce_ = std::chrono::milliseconds(100);  // quiet time that ends a burst
+    std::atomic<uint32_t>  conversions_ = 0;  // attempted, including failures
+
+    Watcher(const std::filesystem::path &in_dir, const std::filesystem::path &out_dir, const ConvertOptions &options)
+            : in_dir_(in_dir), out_dir_(out_dir), options_(options) {
+        std::filesystem::create_directories(out_dir_);
+        if (std::filesystem::equivalent(in_dir_, out_dir_)) {
+            throw std::invalid_argument("--watch needs separate input & output directories");
+        }
+        if (options_.model_resolver) {
+            throw std::invalid_argument("--watch only follows models in model_dir");
+        }
+        options_.model_cache  = &models_;
+        options_.print_report = false;
+    }
+
+    // converts any out of date maps, then watches until stop is set
+    void run(const std::atomic<bool> &stop) {
+#ifdef __linux__
+        int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd == -1) { throw std::runtime_error(std::string("inotify_init1 failed: ") + strerror(errno)); }
+        // NOTE: watches are added before the first scan, so no change in between is missed
+        addWatch(fd, in_dir_, IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (std::filesystem::is_directory(options_.model_dir)) { watchModels(fd, options_.model_dir); }
+
+        std::thread worker([this]() { work(); });
+        std::vector<std::pair<std::string, Change>> initial;
+        for (auto &file : std::filesystem::directory_iterator(in_dir_)) {
+            if (!isMap(file.path())) { continue; }
+            std::string name = file.path().filename().string();
+            std::error_code error;
+            auto out_time = std::filesystem::last_write_time(out_dir_ / name, error);
+            if (error || out_time < file.last_write_time()) {
+                initial.push_back({name, {Clock::now(), "out of date"}});
+            } else {
+                scan(name);  // up to date, but its models are still worth watching
+            }
+        }
+        queue(initial);
+
+        std::map<std::string, Change> burst;  // map: its earliest change
+        Clock::time_point last_event;
+        alignas(inotify_event) char buffer[16384];
+        while (!stop) {
+            pollfd ready = {fd, POLLIN, 0};
+            int timeout = burst.empty() ? 100 : static_cast<int>(debounce_.count());
+            if (poll(&ready, 1, timeout) > 0) {
+                ssize_t length;
+                while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+                    last_event = Clock::now();
+                    for (char *at = buffer; at < buffer + length; at += sizeof(inotify_event) + reinterpret_cast<inotify_event*>(at)->len) {
+                        handle(fd, *reinterpret_cast<inotify_event*>(at), last_event, burst);
+                    }
+                }
+            }
+            if (!burst.empty() && Clock::now() - last_event >= debounce_) {
+                queue({burst.begin(), burst.end()});
+                burst.clear();
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        worker.join();
+        close(fd);
+#else
+        (void)stop;
+        throw std::runtime_error("--watch needs inotify, which is Linux only");
+#endif
+    }
+
+  private:
+    struct Change {
+        Clock::time_point  when;
+        std::string        cause;  // for the log
+    };
+
+    std::mutex                                         mutex_;  // guards everything below
+    std::condition_variable                            wake_;
+    std::deque<std::pair<std::string, Change>>         pending_;  // maps to convert, oldest first
+    bool                                               stopping_ = false;
+    std::map<std::string, std::set<std::string>>       map_models_;  // map: normalised model paths it uses
+    std::map<int, std::filesystem::path>               watches_;  // inotify watch descriptor: directory
+
+    static bool isMap(const std::filesystem::path &path) {
+        return path.extension() == ".bsp";
+    }
+
+    static std::string normalise(const std::filesystem::path &path) {
+        return path.lexically_normal().string();
+    }
+
+#ifdef __linux__
+    void addWatch(int fd, const std::filesystem::path &dir, uint32_t mask) {
+        int wd = inotify_add_watch(fd, dir.c_str(), mask);
+        if (wd == -1) {
+            throw std::runtime_error("Couldn't watch " + dir.string() + ": " + strerror(errno));
+        }
+        watches_[wd] = dir;
+    }
+
+    void watchModels(int fd, const std::filesystem::path &dir) {
+        const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE | IN_ONLYDIR;
+        addWatch(fd, dir, mask);
+        for (auto &sub : std::filesystem::recursive_directory_iterator(dir)) {
+            if (sub.is_directory()) { addWatch(fd, sub.path(), mask); }
+        }
+    }
+
+    void handle(int fd, const inotify_event &event, Clock::time_point when, std::map<std::string, Change> &burst) {
+        auto watch = watches_.find(event.wd);
+        if (watch == watches_.end() || event.len == 0) { return; }
+        std::filesystem::path path = watch->second / event.name;
+        auto touch = [&](const std::string &map, const std::string &cause) {
+            burst.try_emplace(map, Change{when, cause});  // keeps the earliest, for turnaround time
+        };
+        if (watch->second == in_dir_) {
+            if (isMap(path)) { touch(path.filename().string(), "map changed"); }
+            return;
+        }
+        if ((event.mask & IN_ISDIR) != 0) {
+            if ((event.mask & (IN_CREATE | IN_MOVED_TO)) != 0) {
+                watchModels(fd, path);
+            }
+            return;
+        }
+        std::string model = normalise(path);
+        models_.invalidate(model);
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &[map, models] : map_models_) {
+            if (models.count(model)) { touch(map, "model " + path.filename().string() + " changed"); }
+        }
+    }
+#endif
+
+    void queue(const std::vector<std::pair<std::string, Change>> &maps) {
+        if (maps.empty()) { return; }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto &[map, change] : maps) {
+                bool queued = false;  // a map queued again before its turn is converted once, for its earliest change
+                for (auto &[pending, _] : pending_) { queued = queued || pending == map; }
+                if (!queued) { pending_.push_back({map, change}); }
+            }
+        }
+        wake_.notify_all();
+    }
+
+    // records which models a map uses, so their changes reconvert it
+    void scan(const std::string &map) {
+        std::set<std::string> models;
+        try {
+            Bsp r1bsp((in_dir_ / map).string().c_str());
+            if (r1bsp.is_valid()) {
+                GameLumpView<titanfall::StaticProp> gameLump(r1bsp);
+                for (const ModelDictEntry &entry : gameLump.model_names_) {
+                    models.insert(normalise(modelPath(options_, entry)));
+                }
+            }
+        } catch (std::exception &) {}  // convert reports it
+        std::lock_guard<std::mutex> lock(mutex_);
+        map_models_[map] = std::move(models);
+    }
+
+    // background thread: converts pending maps, 1 at a time
+    void work() {
+        while (true) {
+            std::pair<std::string, Change> next;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [this]() { return stopping_ || !pending_.empty(); });
+                if (stopping_) { return; }
+                next = pending_.front();
+                pending_.pop_front();
+            }
+            auto &[map, change] = next;
+            scan(map);
+            Clock::time_point start = Clock::now();
+            uint32_t warm = models_.hits_;
+            std::string in_filename = (in_dir_ / map).string(), out_filename = (out_dir_ / map).string();
+            int ret = 1;
+            std::string error;
+            try {
+                ret = convert(in_filename.c_str(), out_filename.c_str(), options_);
+            } catch (std::exception &e) {
+                error = e.what();
+            }
+            conversions_++;
+            Clock::time_point end = Clock::now();
+            auto ms = [](Clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count(); };
+            if (ret == 0) {
+                printf("%s: converted in %.0f ms, %.0f ms after the change (%s, %u warm models)\n", map.c_str(),
+                    ms(end - start), ms(end - change.when), change.cause.c_str(), models_.hits_ - warm);
+            } else {
+                fprintf(stderr, "%s: conversion failed (%s)%s%s\n", map.c_str(), change.cause.c_str(),
+                    error.empty() ? "" : ": ", error.c_str());
+            }
+            fflush(stdout);
+        }
+    }
+};
@@ -0,0 +1,77 @@
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "analyze.hpp"
+#include "convert.hpp"
+#include "synthetic.hpp"
+
+namespace fs = std::filesystem;
+
+
+int main(int argc, char* argv[]) {
+    fs::path work = fs::temp_directory_path() / "bsp_regen_analyze";
+    fs::remove_all(work);
+    std::vector<std::string> maps;
+    for (uint64_t seed = 1; seed <= 4; seed++) {
+        maps.push_back(synthetic::write_map(work, "map_" + std::to_string(seed), seed, static_cast<uint32_t>(seed * 200)).string());
+    }
+    synthetic::write_file(work / "junk.bsp", std::vector<char>(16, 'x'));
+    maps.push_back((work / "junk.bsp").string());
+    std::string model_dir = (work / "r1").string();
+
+    int failures = 0;
+    auto check = [&](bool ok, const std::string &message) {
+        if (!ok) { printf("FAILED: %s\n", message.c_str()); failures++; }
+    };
+
+    ConvertOptions options = {.num_threads = 4, .print_report = false, .write_hashes = false, .model_dir = model_dir.c_str()};
+    std::vector<MapAnalysis> analyses = analyze(maps, options);
+    check(analyses.size() == maps.size(), "every map is analysed");
+    for (size_t i = 0; i + 1 < maps.size(); i++) {
+        const MapAnalysis &analysis = analyses[i];
+        check(analysis.filename == maps[i] && analysis.error.empty(), maps[i] + " analysed in order, w/o errors");
+        std::string output = (work / ("out_" + std::to_string(i) + ".bsp")).string();
+        ConvertOptions serial = options;
+        serial.num_threads = 1;
+        convert(maps[i].c_str(), output.c_str(), serial);
+        check(analysis.projected_size == fs::file_size(output), maps[i] + " projected size");
+        Bsp r2bsp(output.c_str());
+        bool lengths = true;
+        for (int lump = 0; lump < 128; lump++) {
+            lengths = lengths && analysis.lump_lengths[lump] == r2bsp.header_->lumps[lump].length;
+        }
+        check(lengths, maps[i] + " projected lump lengths");
+        check(analysis.capacity.geo_sets == r2bsp.get_lump_length(titanfall::CM_GEO_SETS) / sizeof(titanfall::GeoSet),
+            maps[i] + " GeoSets counted");
+        check(analysis.capacity.unique_contents == r2bsp.get_lump_length(titanfall::CM_UNIQUE_CONTENTS) / sizeof(uint32_t),
+            maps[i] + " UniqueContents counted");
+        // every synthetic prop model is solid (0x1) or 0x0, so each prop primitive should reference 0xEB0280
+        auto r2Contents = r2bsp.get_lump<uint32_t>(titanfall::CM_UNIQUE_CONTENTS);
+        std::vector<uint32_t> primitives;
+        for (const titanfall::GeoSet &geo_set : r2bsp.get_lump<titanfall::GeoSet>(titanfall::CM_GEO_SETS)) {
+            if (geo_set.num_primitives == 1) { primitives.push_back(geo_set.primitive); }
+        }
+        for (uint32_t primitive : r2bsp.get_lump<uint32_t>(titanfall::CM_PRIMITIVES)) {
+            primitives.push_back(primitive);
+        }
+        bool prop_contents = true;
+        for (uint32_t primitive : primitives) {
+            if (primitive >> 24 != titanfall::PROP) { continue; }
+            uint32_t index = primitive & 0xFF;
+            prop_contents = prop_contents && index < r2Contents.size() && r2Contents[index] == 0xEB0280;
+        }
+        check(prop_contents, maps[i] + " props reference their own UniqueContents");
+        check(analysis.headroom() > 0 && analysis.headroom() < 1, maps[i] + " headroom");
+    }
+    check(!analyses.back().error.empty() && analyses.back().projected_size == 0, "junk fails");
+
+    CapacityReport over;
+    check(over.exceeded().empty(), "empty report is within limits");
+    over.max_prop_index = 0x10000;
+    check(over.exceeded().find("Prop index") == 0, "prop index overflow is reported");
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,120 @@
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "convert.hpp"
+#include "synthetic.hpp"
+
+namespace fs = std::filesystem;
+typedef std::chrono::steady_clock Clock;
+
+
+int main(int argc, char* argv[]) {
+    fs::path work = fs::temp_directory_path() / "bsp_regen_cancel";
+    fs::remove_all(work);
+    fs::path input = synthetic::write_map(work, "map", 9, 20000, 32 << 20);
+    std::string model_dir = (work / "r1").string();
+    fs::path out_dir = work / "out";
+    fs::create_directories(out_dir);
+    std::string output = (out_dir / "map.bsp").string();
+
+    int failures = 0;
+    auto check = [&](bool ok, const std::string &message) {
+        if (!ok) { printf("FAILED: %s\n", message.c_str()); failures++; }
+    };
+    auto leftovers = [&]() { return std::distance(fs::directory_iterator(out_dir), fs::directory_iterator()); };
+
+    // progress: every stage reaches 1, never going backwards
+    {
+        ConversionContext context;
+        std::map<std::string, float> last;
+        bool monotonic = true;
+        context.progress_ = [&](const char *stage, float fraction) {
+            monotonic = monotonic && fraction >= last[stage] && fraction <= 1;
+            last[stage] = fraction;
+        };
+        ConvertOptions options = {.num_threads = 4, .print_report = false, .model_dir = model_dir.c_str(), .context = &context};
+        check(convert(input.string().c_str(), output.c_str(), options) == 0, "converts w/ a context");
+        check(monotonic, "progress never goes backwards");
+        for (const char *stage : {"convertTricoll", "addPropsToCmGrid", "writeLump"}) {
+            check(last.count(stage) && last[stage] == 1.0f, std::string(stage) + " reports its progress up to 1");
+        }
+        fs::remove_all(out_dir);
+        fs::create_directories(out_dir);
+    }
+
+    // a deadline that has already passed stops the conversion before it writes anything
+    {
+        ConversionContext context;
+        context.setTimeout(std::chrono::seconds(0));
+        ConvertOptions options = {.print_report = false, .model_dir = model_dir.c_str(), .context = &context};
+        bool timed_out = false;
+        try {
+            convert(input.string().c_str(), output.c_str(), options);
+        } catch (Cancelled &e) {
+            timed_out = e.timed_out_;
+        }
+        check(timed_out, "a passed deadline throws Cancelled w/ timed_out_");
+        check(leftovers() == 0, "nothing is left behind after a timeout");
+    }
+
+    // cancelled at the n-th progress report, from inside the callback: every output is removed
+    // -- & the latency from cancel() to the conversion throwing is bounded (by the largest chunk between checks)
+    double worst_ms = 0;
+    for (IoBackend io : {IoBackend::MMAP, IoBackend::PWRITE, IoBackend::URING}) {
+        for (unsigned threads : {1u, 4u}) {
+            for (int n = 0; ; n++) {
+                ConversionContext context;
+                int reports = 0;
+                Clock::time_point cancelled_at;
+                context.progress_ = [&](const char *, float) {
+                    if (reports++ == n) {
+                        cancelled_at = Clock::now();
+                        context.cancel();
+                    }
+                };
+                ConvertOptions options = {.num_threads = threads, .print_report = false, .model_dir = model_dir.c_str(),
+                    .external_threshold = 1 << 20, .io = io, .context = &context};
+                bool cancelled = false;
+                try {
+                    convert(input.string().c_str(), output.c_str(), options);
+                } catch (Cancelled &) {
+                    cancelled = true;
+                    worst_ms = std::max(worst_ms, std::chrono::duration<double, std::milli>(Clock::now() - cancelled_at).count());
+                }
+                std::string name = std::string(io_backend_name(io)) + ", -j " + std::to_string(threads) + ", report " + std::to_string(n);
+                if (!cancelled) {  // cancelled after the last check; the conversion completes as normal
+                    check(n > 0 && fs::exists(output), name + ": completes if cancelled too late");
+                    fs::remove_all(out_dir);
+                    fs::create_directories(out_dir);
+                    break;
+                }
+                check(leftovers() == 0, name + ": partial outputs are removed");
+            }
+        }
+    }
+    printf("worst cancel latency: %.2f ms\n", worst_ms);
+    check(worst_ms < 250, "cancel latency is bounded");
+
+    // cancelled from another thread, part way through
+    {
+        ConversionContext context;
+        ConvertOptions options = {.num_threads = 4, .print_report = false, .model_dir = model_dir.c_str(), .context = &context};
+        std::thread canceller([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            context.cancel();
+        });
+        try {
+            convert(input.string().c_str(), output.c_str(), options);
+        } catch (Cancelled &) {}
+        canceller.join();
+        check(leftovers() == 0 || (fs::exists(output) && leftovers() == 2), "no partial output after a cancel from another thread");
+    }
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
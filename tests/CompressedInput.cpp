@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bsp.hpp"
+#include "compressed.hpp"
+#include "convert.hpp"
+#include "synthetic.hpp"
+
+namespace fs = std::filesystem;
+
+
+std::string read_file(const fs::path &path) {
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+
+void write_file(const fs::path &path, const std::string &data) {
+    std::ofstream file(path, std::ios::binary);
+    file.write(data.data(), data.size());
+}
+
+
+#ifdef BSP_REGEN_HAVE_LZMA
+std::string xz(const std::string &data) {
+    std::string out(lzma_stream_buffer_bound(data.size()), '\0');
+    size_t length = 0;
+    lzma_ret ret = lzma_easy_buffer_encode(1, LZMA_CHECK_CRC64, nullptr, reinterpret_cast<const uint8_t*>(data.data()), data.size(),
+        reinterpret_cast<uint8_t*>(out.data()), &length, out.size());
+    if (ret != LZMA_OK) { throw std::runtime_error("lzma_easy_buffer_encode failed"); }
+    out.resize(length);
+    return out;
+}
+#endif
+
+
+#ifdef BSP_REGEN_HAVE_ZSTD
+// pledged: whether the frame header records the decompressed size
+std::string zstd(const std::string &data, bool pledged) {
+    std::string out(ZSTD_compressBound(data.size()), '\0');
+    ZSTD_CCtx *context = ZSTD_createCCtx();
+    ZSTD_CCtx_setParameter(context, ZSTD_c_contentSizeFlag, pledged ? 1 : 0);
+    ZSTD_CCtx_setParameter(context, ZSTD_c_checksumFlag, 1);  // as the zstd CLI does; w/o it, corruption can go unnoticed
+    if (pledged) { ZSTD_CCtx_setPledgedSrcSize(context, data.size()); }
+    ZSTD_inBuffer in = {data.data(), data.size(), 0};
+    ZSTD_outBuffer out_buffer = {out.data(), out.size(), 0};
+    size_t ret = ZSTD_compressStream2(context, &out_buffer, &in, ZSTD_e_end);
+    ZSTD_freeCCtx(context);
+    if (ret != 0) { throw std::runtime_error("ZSTD_compressStream2 failed"); }
+    out.resize(out_buffer.pos);
+    return out;
+}
+#endif
+
+
+// compressed inputs convert to the same bytes as the plain .bsp; w/ --mib, times reading one directly
+// against decompressing it to a temporary .bsp first, as was needed before
+int main(int argc, char* argv[]) {
+    size_t mib = 1;
+    int repeats = 5;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--mib") == 0 && i + 1 < argc) {
+            mib = std::max<size_t>(1, strtoull(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--repeats") == 0 && i + 1 < argc) {
+            repeats = std::max(1, atoi(argv[++i]));
+        } else {
+            printf("USAGE: %s [--mib size] [--repeats count]\n", argv[0]);
+            return 0;
+        }
+    }
+    fs::path work = fs::temp_directory_path() / "bsp_regen_compressed_input";
+    fs::remove_all(work);
+    fs::path input = synthetic::write_map(work, "map", 9, 1500, mib << 20);
+    std::string model_dir = (work / "r1").string();
+
+    int failures = 0;
+    auto check = [&](bool ok, const std::string &message) {
+        if (!ok) { printf("FAILED: %s\n", message.c_str()); failures++; }
+    };
+
+    ConvertOptions options = {.num_threads = std::max(1u, std::thread::hardware_concurrency()),
+        .print_report = false, .write_hashes = false, .model_dir = model_dir.c_str()};
+    std::string reference = (work / "reference.bsp").string();
+    check(convert(input.string().c_str(), reference.c_str(), options) == 0, "converts the plain .bsp");
+    std::string plain = read_file(input), expected = read_file(reference);
+
+    struct Case { std::string name; compressed::Format format; std::string data; };
+    std::vector<Case> cases;
+#ifdef BSP_REGEN_HAVE_LZMA
+    cases.push_back({"xz", compressed::Format::XZ, xz(plain)});
+    // the index only covers 1 stream, so this is decoded w/o knowing its size
+    cases.push_back({"xz (2 streams)", compressed::Format::XZ, xz(plain.substr(0, plain.size() / 2)) + xz(plain.substr(plain.size() / 2))});
+#endif
+#ifdef BSP_REGEN_HAVE_ZSTD
+    cases.push_back({"zstd", compressed::Format::ZSTD, zstd(plain, true)});
+    cases.push_back({"zstd (no content size)", compressed::Format::ZSTD, zstd(plain, false)});
+    // content sizes are summed frame by frame; 1 frame w/o one leaves the total unknown
+    std::string front = plain.substr(0, plain.size() / 2), back = plain.substr(plain.size() / 2);
+    cases.push_back({"zstd (2 frames)", compressed::Format::ZSTD, zstd(front, true) + zstd(back, true)});
+    cases.push_back({"zstd (2 frames, 1 w/o content size)", compressed::Format::ZSTD, zstd(front, true) + zstd(back, false)});
+#else
+    try {  // recognised, but refused
+        std::string frame = "\x28\xB5\x2F\xFD" + std::string(64, '\0');
+        Bsp bsp(frame.data(), frame.size());
+        check(false, "zstd input is refused w/o zstd support");
+    } catch (std::runtime_error &e) {
+        check(strstr(e.what(), "can't read zstd") != nullptr, std::string("zstd input is refused w/o zstd support: ") + e.what());
+    }
+#endif
+    if (cases.empty()) { printf("no codecs built in\n"); }
+
+    for (Case &test : cases) {
+        check(compressed::detect(test.data.data(), test.data.size()) == test.format, test.name + " is detected");
+        fs::path path = work / ("map.bsp." + test.name.substr(0, test.name.find(' ')));
+        write_file(path, test.data);
+        std::string output = (work / "from_compressed.bsp").string();
+        check(convert(path.string().c_str(), output.c_str(), options) == 0, test.name + " converts");
+        check(read_file(output) == expected, test.name + " converts to the same bytes as the plain .bsp");
+
+        Bsp bsp(test.data.data(), test.data.size());  // decoded into memory the Bsp owns
+        check(bsp.compression_ == test.format && bsp.file_.size() == plain.size()
+            && memcmp(bsp.file_.rawdata(), plain.data(), plain.size()) == 0, test.name + " decodes in memory");
+
+        std::string truncated = test.data.substr(0, test.data.size() - 64);
+        std::string corrupt = test.data;
+        corrupt[corrupt.size() / 2] ^= 0x55;
+        for (auto &[what, data] : {std::pair{"truncated", truncated}, std::pair{"corrupt", corrupt}}) {
+            try {
+                Bsp broken(data.data(), data.size());
+                check(false, test.name + ": " + what + " input throws");
+            } catch (std::runtime_error &) {}
+        }
+    }
+
+    if (argc > 1 && !cases.empty()) {
+        Case &test = cases[0];
+        fs::path path = work / "map.bsp.bench", temporary = work / "decompressed.bsp";
+        write_file(path, test.data);
+        std::string output = (work / "bench.bsp").string();
+        auto median = [&](auto &&run) {
+            std::vector<double> times;
+            for (int i = 0; i < repeats; i++) {
+                auto start = std::chrono::steady_clock::now();
+                run();
+                times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            }
+            std::sort(times.begin(), times.end());
+            return times[times.size() / 2] * 1000;
+        };
+        double staged = median([&]() {
+            memory_mapped_file decoded;
+            std::string data = read_file(path);
+            compressed::decompress(test.format, data.data(), data.size(), decoded);
+            std::ofstream file(temporary, std::ios::binary);
+            file.write(decoded.rawdata(), decoded.size());
+            file.close();
+            convert(temporary.string().c_str(), output.c_str(), options);
+        });
+        double direct = median([&]() { convert(path.string().c_str(), output.c_str(), options); });
+        printf("%zu MiB map as %s (%zu MiB), median of %d conversions\n", plain.size() >> 20, test.name.c_str(),
+            test.data.size() >> 20, repeats);
+        printf("  decompress to .bsp, then convert  %8.2f ms\n", staged);
+        printf("  convert directly                  %8.2f ms\n", direct);
+    }
+
+    fs::remove_all(work);
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
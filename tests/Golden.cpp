@@ -0,0 +1,230 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "bsp.hpp"
+#include "convert.hpp"
+#include "lumps.hpp"
+#include "synthetic.hpp"
+#include "tasks.hpp"
+#include "titanfall.hpp"
+
+namespace fs = std::filesystem;
+
+
+struct Case {
+    std::string  name;
+    fs::path     input;
+    std::string  model_dir;
+    std::string  log;  // filled in by run_case
+    bool         passed = false;
+};
+
+
+// one element of lump index, decoded by type where we know it
+std::string describe(int index, const char *element) {
+    char buffer[256];
+    switch (index) {
+        case titanfall::CM_GRID: {
+            titanfall::Grid g;
+            memcpy(&g, element, sizeof(g));
+            snprintf(buffer, 256, "Grid{scale=%g, cell_offset={%d, %d}, num_cells={%d, %d}, num_straddle_groups=%d, first_brush_plane=%d}",
+                g.scale, g.cell_offset[0], g.cell_offset[1], g.num_cells[0], g.num_cells[1], g.num_straddle_groups, g.first_brush_plane);
+            break;
+        }
+        case titanfall::CM_GRID_CELLS: {
+            titanfall::GridCell c;
+            memcpy(&c, element, sizeof(c));
+            snprintf(buffer, 256, "GridCell{first_geo_set=%u, num_geo_sets=%u}", c.first_geo_set, c.num_geo_sets);
+            break;
+        }
+        case titanfall::CM_GEO_SETS: {
+            titanfall::GeoSet g;
+            memcpy(&g, element, sizeof(g));
+            snprintf(buffer, 256, "GeoSet{straddle_group=%u, num_primitives=%u, primitive={type=0x%02X, index=%u, contents=%u}}",
+                g.straddle_group, g.num_primitives, g.primitive >> 24, (g.primitive >> 8) & 0xFFFF, g.primitive & 0xFF);
+            break;
+        }
+        case titanfall::CM_PRIMITIVES: {
+            uint32_t p;
+            memcpy(&p, element, sizeof(p));
+            snprintf(buffer, 256, "Primitive{type=0x%02X, index=%u, contents=%u}", p >> 24, (p >> 8) & 0xFFFF, p & 0xFF);
+            break;
+        }
+        case titanfall::CM_GEO_SET_BOUNDS:
+        case titanfall::CM_PRIMITIVE_BOUNDS: {
+            titanfall::Bounds b;
+            memcpy(&b, element, sizeof(b));
+            snprintf(buffer, 256, "Bounds{origin={%d, %d, %d}, sin=%d, extents={%d, %d, %d}, cos=%d}",
+                b.origin[0], b.origin[1], b.origin[2], b.sin, b.extents[0], b.extents[1], b.extents[2], b.cos);
+            break;
+        }
+        case titanfall::TRICOLL_HEADER: {
+            titanfall::TricollHeader h;
+            memcpy(&h, element, sizeof(h));
+            snprintf(buffer, 256, "TricollHeader{flags=%d, num_vertices=%d, num_triangles=%u, num_bevel_indices=%u, "
+                "first_vertex=%d, first_triangle=%u, first_node=%u, first_bevel_index=%u, scale=%g}",
+                h.flags, h.num_vertices, h.num_triangles, h.num_bevel_indices,
+                h.first_vertex, h.first_triangle, h.first_node, h.first_bevel_index, h.scale);
+            break;
+        }
+        default: {  // hex dump, up to 32 bytes
+            uint32_t size = std::min(lumps::DESCRIPTORS[index].r2_element_size, 32u);
+            int length = 0;
+            for (uint32_t i = 0; i < size; i++) {
+                length += snprintf(&buffer[length], 256 - length, "%02X ", static_cast<uint8_t>(element[i]));
+            }
+            if (length > 0) { buffer[length - 1] = '\0'; }
+        }
+    }
+    return buffer;
+}
+
+
+// appends every difference between the output & golden headers, and the first differing element of each lump
+bool compare(const fs::path &output, const fs::path &golden, std::string &log) {
+    Bsp out(output.string().c_str());
+    Bsp ref(golden.string().c_str());
+    char buffer[512];
+    bool same = true;
+    auto note = [&](const std::string &line) { log += "  " + line + "\n"; same = false; };
+
+    if (out.header_->version != ref.header_->version || out.header_->revision != ref.header_->revision) {
+        note("BspHeader version / revision differ");
+    }
+    for (int i = 0; i < 128; i++) {
+        LumpHeader &a = out.header_->lumps[i];
+        LumpHeader &b = ref.header_->lumps[i];
+        const lumps::Descriptor &descriptor = lumps::DESCRIPTORS[i];
+        if (a.length != b.length || a.version != b.version || a.fourCC != b.fourCC) {
+            snprintf(buffer, 512, "%s (0x%02X): LumpHeader {length=%u, version=%u} != golden {length=%u, version=%u}",
+                descriptor.name, i, a.length, a.version, b.length, b.version);
+            note(buffer);
+        } else if (a.offset != b.offset) {
+            snprintf(buffer, 512, "%s (0x%02X): offset 0x%X != golden 0x%X", descriptor.name, i, a.offset, b.offset);
+            note(buffer);
+        }
+        // compare the common prefix, even if the lengths differ
+        uint32_t length = std::min(a.length, b.length);
+        if (a.offset + length > out.file_.size() || b.offset + length > ref.file_.size()) {
+            note(std::string(descriptor.name) + ": lump is past the end of the file");
+            continue;
+        }
+        const char *lhs = out.file_.rawdata<const char>(a.offset);
+        const char *rhs = ref.file_.rawdata<const char>(b.offset);
+        if (memcmp(lhs, rhs, length) == 0) { continue; }
+        uint32_t byte = 0;
+        while (lhs[byte] == rhs[byte]) { byte++; }
+        uint32_t element_size = descriptor.r2_element_size;
+        uint32_t element = byte / element_size;
+        snprintf(buffer, 512, "%s (0x%02X): first difference in element %u (byte 0x%X)", descriptor.name, i, element, byte);
+        note(buffer);
+        if ((element + 1) * element_size <= length) {
+            note("    output: " + describe(i, &lhs[element * element_size]));
+            note("    golden: " + describe(i, &rhs[element * element_size]));
+        }
+    }
+    if (out.file_.size() != ref.file_.size()) {
+        snprintf(buffer, 512, "file size %zu != golden %zu", out.file_.size(), ref.file_.size());
+        note(buffer);
+    }
+    return same;
+}
+
+
+int main(int argc, char* argv[]) {
+    bool update = false;
+    fs::path corpus = "corpus";  // *.bsp, w/ models in corpus/r1/
+    fs::path golden = "golden";
+    // per process, so concurrent runs don't overwrite each other's inputs & outputs
+    fs::path work   = fs::temp_directory_path() / ("bsp_regen_golden_" + std::to_string(getpid()));
+    unsigned num_threads = std::thread::hardware_concurrency();
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--update") == 0) {
+            update = true;
+        } else if (strcmp(argv[i], "--corpus") == 0 && i + 1 < argc) {
+            corpus = argv[++i];
+        } else if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc) {
+            golden = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            num_threads = static_cast<unsigned>(atoi(argv[++i]));
+        } else {
+            printf("USAGE: %s [--update] [--corpus dir] [--golden dir] [-j num_threads]\n", argv[0]);
+            return 0;
+        }
+    }
+
+    // synthetic maps first, so the harness has something to check w/o a local corpus
+    std::vector<Case> cases;
+    const uint64_t seeds[] = {1, 2, 3, 4};
+    const uint32_t num_props[] = {0, 16, 256, 2048};
+    for (int i = 0; i < 4; i++) {
+        std::string name = "synthetic_" + std::to_string(seeds[i]);
+        fs::path input = synthetic::write_map(work / "synthetic", name, seeds[i], num_props[i]);
+        cases.push_back({name, input, (work / "synthetic" / "r1").string()});
+    }
+    if (fs::is_directory(corpus)) {
+        std::vector<fs::path> maps;
+        for (auto &entry : fs::directory_iterator(corpus)) {
+            if (entry.path().extension() == ".bsp") { maps.push_back(entry.path()); }
+        }
+        std::sort(maps.begin(), maps.end());
+        for (auto &map : maps) {
+            cases.push_back({map.stem().string(), map, (corpus / "r1").string()});
+        }
+    }
+    fs::create_directories(golden);
+    fs::create_directories(work / "out");
+
+    // each map is converted on 1 thread, maps are converted in parallel
+    auto start = std::chrono::steady_clock::now();
+    TaskGraph graph;
+    for (Case &c : cases) {
+        graph.add(c.name.c_str(), [&c, &golden, &work, update]() {
+            fs::path output = work / "out" / (c.name + ".bsp");
+            fs::path reference = golden / (c.name + ".bsp");
+            ConvertOptions options;
+            options.print_report = false;
+            options.verify = true;
+            options.write_hashes = false;
+            options.model_dir = c.model_dir.c_str();
+            try {
+                if (convert(c.input.string().c_str(), output.string().c_str(), options) != 0) {
+                    c.log = "  conversion failed\n";
+                    return;
+                }
+            } catch (std::exception &e) {
+                c.log = std::string("  conversion failed: ") + e.what() + "\n";
+                return;
+            }
+            if (update) {
+                fs::copy_file(output, reference, fs::copy_options::overwrite_existing);
+                c.passed = true;
+            } else if (!fs::exists(reference)) {
+                c.log = "  no golden output, run with --update to create it\n";
+            } else {
+                c.passed = compare(output, reference, c.log);
+            }
+        });
+    }
+    graph.run(num_threads);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int failures = 0;
+    for (Case &c : cases) {
+        printf("%s %s\n", c.passed ? (update ? "UPDATED" : "OK     ") : "FAILED ", c.name.c_str());
+        printf("%s", c.log.c_str());
+        if (!c.passed) { failures++; }
+    }
+    fs::remove_all(work);
+    printf("%zu maps in %.2fs, %d failures\n", cases.size(), seconds, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,112 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "bsp.hpp"
+#include "cm_query.hpp"
+#include "game_lump.hpp"
+#include "perf_counters.hpp"
+#include "titanfall.hpp"
+#include "titanfall2.hpp"
+
+
+// solid_type != 0 for each GAME_LUMP.sprp.props; empty if the map has no sprp
+template <typename StaticProp>
+std::vector<bool> collidableProps(Bsp &bsp) {
+    GameLumpView<StaticProp> game_lump(bsp);
+    std::vector<bool> collidable;
+    for (const StaticProp &prop : game_lump.props_) {
+        collidable.push_back(prop.solid_type != 0);
+    }
+    return collidable;
+}
+
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printf("USAGE: %s map.bsp [num_queries] [seed]\n", argv[0]);
+        return 0;
+    }
+    int num_queries = argc > 2 ? atoi(argv[2]) : 100000;
+    unsigned seed = argc > 3 ? static_cast<unsigned>(atoi(argv[3])) : 0;
+
+    Bsp bsp(argv[1]);
+    if (!bsp.is_valid()) {
+        fprintf(stderr, "'%s' is not a Titanfall map!\n", argv[1]);
+        return 1;
+    }
+    cm::Grid grid(bsp);
+
+    // every collidable prop must be in at least one GeoSet
+    int ret = 0;
+    std::vector<bool> collidable = bsp.header_->version == titanfall::VERSION
+        ? collidableProps<titanfall::StaticProp>(bsp)
+        : collidableProps<titanfall2::StaticProp>(bsp);
+    std::vector<bool> reachable = grid.reachableProps(collidable.size());
+    int num_unreachable = 0;
+    for (size_t i = 0; i < collidable.size(); i++) {
+        if (collidable[i] && !reachable[i]) {
+            if (num_unreachable++ < 16) {
+                fprintf(stderr, "prop %zu is not reachable from any GridCell\n", i);
+            }
+        }
+    }
+    printf("%zu props, %d collidable props unreachable\n", collidable.size(), num_unreachable);
+    if (num_unreachable) { ret = 1; }
+
+    // random queries inside the grid
+    Vector3 mins, maxs;
+    grid.extents(mins, maxs);
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> x(mins.x, maxs.x), y(mins.y, maxs.y), z(-4096, 4096);
+    std::uniform_real_distribution<float> size(8, grid.grid_.scale);
+    std::vector<cm::Ray> rays;
+    std::vector<std::pair<Vector3, Vector3>> boxes;
+    for (int i = 0; i < num_queries; i++) {
+        rays.push_back({{x(rng), y(rng), z(rng)}, {x(rng), y(rng), z(rng)}});
+        Vector3 centre = {x(rng), y(rng), z(rng)};
+        float half = size(rng) / 2;
+        boxes.push_back({
+            {centre.x - half, centre.y - half, centre.z - half},
+            {centre.x + half, centre.y + half, centre.z + half}});
+    }
+
+    // timed w/ hardware counters, then again counting the cache lines each query reads
+    std::vector<uint32_t> hits;
+    perf_counters::Report perf;
+    #define BENCHMARK(name, query) { \
+        cm::QueryStats stats; \
+        auto start = std::chrono::steady_clock::now(); \
+        { \
+            perf_counters::Scope scope(name, &perf); \
+            for (int i = 0; i < num_queries; i++) { hits.clear(); query; } \
+        } \
+        auto end = std::chrono::steady_clock::now(); \
+        double ns = std::chrono::duration<double, std::nano>(end - start).count(); \
+        double n = static_cast<double>(stats.queries); \
+        uint64_t lines; \
+        { \
+            cm::QueryStats stats; \
+            grid.trace_lines_ = true; \
+            for (int i = 0; i < num_queries; i++) { hits.clear(); query; } \
+            grid.trace_lines_ = false; \
+            lines = stats.lines_touched; \
+        } \
+        const perf_counters::Counts &counts = perf.stages.back().second; \
+        char misses[32] = "n/a"; \
+        if (counts.available[perf_counters::CACHE_MISSES]) { \
+            snprintf(misses, 32, "%.2f", counts.values[perf_counters::CACHE_MISSES] / n); } \
+        printf("%s: %.1f ns/query, %.2f cells, %.2f GeoSets, %.2f primitives tested, %.2f hits per query\n", \
+            name, ns / n, stats.cells_visited / n, stats.geo_sets_visited / n, \
+            stats.primitives_tested / n, stats.primitives_hit / n); \
+        printf("%s: %.2f cache lines read, %s cache misses per query\n", name, lines / n, misses); }
+
+    BENCHMARK("box", grid.queryBox(boxes[i].first, boxes[i].second, hits, stats));
+    BENCHMARK("ray", grid.queryRay(rays[i], hits, stats));
+
+    #undef BENCHMARK
+
+    return ret;
+}
@@ -0,0 +1,101 @@
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "bounds.hpp"
+#include "cm_query.hpp"
+#include "convert.hpp"
+#include "grid_tuning.hpp"
+#include "synthetic.hpp"
+
+namespace fs = std::filesystem;
+
+
+int main(int argc, char* argv[]) {
+    fs::path work = fs::temp_directory_path() / "bsp_regen_grid_tuning";
+    fs::remove_all(work);
+    fs::path input = synthetic::write_map(work, "map", 7, 1000);
+    std::string model_dir = (work / "r1").string();
+
+    int failures = 0;
+    auto check = [&](bool ok, const std::string &message) {
+        if (!ok) { printf("FAILED: %s\n", message.c_str()); failures++; }
+    };
+
+    Bsp r1bsp(input.string().c_str());
+    titanfall::Grid r1Grid = r1bsp.get_lump<titanfall::Grid>(titanfall::CM_GRID)[0];
+    auto r1Cells     = r1bsp.get_lump<titanfall::GridCell>(titanfall::CM_GRID_CELLS);
+    auto r1GeoSets   = r1bsp.get_lump<titanfall::GeoSet>(titanfall::CM_GEO_SETS);
+    auto r1GeoBounds = r1bsp.get_lump<titanfall::Bounds>(titanfall::CM_GEO_SET_BOUNDS);
+    int numR1Cells = r1Grid.num_cells[0] * r1Grid.num_cells[1];
+
+    for (float scale : {r1Grid.scale / 2, r1Grid.scale * 2, grid_tuning::AUTO}) {
+        std::string name = scale == grid_tuning::AUTO ? "auto" : std::to_string(static_cast<int>(scale));
+        std::string output = (work / ("scale_" + name + ".bsp")).string();
+        ConvertOptions options = {.print_report = false, .write_hashes = false, .model_dir = model_dir.c_str(), .cm_grid_scale = scale};
+        check(convert(input.string().c_str(), output.c_str(), options) == 0, name + ": converts");
+        Bsp r2bsp(output.c_str());
+        cm::Grid grid(r2bsp);
+        if (scale != grid_tuning::AUTO) {
+            check(grid.grid_.scale == scale, name + ": Grid.scale");
+        }
+        for (int axis = 0; axis < 2; axis++) {
+            check(grid.grid_.cell_offset[axis] * grid.grid_.scale <= r1Grid.cell_offset[axis] * r1Grid.scale
+               && (grid.grid_.cell_offset[axis] + grid.grid_.num_cells[axis]) * grid.grid_.scale
+               >= (r1Grid.cell_offset[axis] + r1Grid.num_cells[axis]) * r1Grid.scale, name + ": covers r1's grid");
+        }
+        check(grid.cells_.size() == static_cast<size_t>(grid.numWorldCells()) + r1Cells.size() - numR1Cells, name + ": bsp Model cells kept");
+
+        GameLumpView<titanfall2::StaticProp> gameLump(r2bsp);
+        std::vector<bool> reachable = grid.reachableProps(gameLump.props_.size());
+        bool all = true;
+        for (size_t i = 0; i < gameLump.props_.size(); i++) { all = all && (gameLump.props_[i].solid_type == 0 || reachable[i]); }
+        check(all, name + ": every collidable prop is reachable");
+
+        // each r1 worldspawn GeoSet is in every cell its bounds overlap; any in more than 1 cell straddles
+        std::map<std::tuple<uint16_t, uint32_t>, std::set<int>> cellsOf;  // {num_primitives, primitive}: cells
+        std::map<std::tuple<uint16_t, uint32_t>, bool> straddles;
+        for (int cell = 0; cell < grid.numWorldCells(); cell++) {
+            for (uint32_t i = 0; i < grid.cells_[cell].num_geo_sets; i++) {
+                titanfall::GeoSet &geo_set = grid.geo_sets_[grid.cells_[cell].first_geo_set + i];
+                cellsOf[{geo_set.num_primitives, geo_set.primitive}].insert(cell);
+                straddles[{geo_set.num_primitives, geo_set.primitive}] = geo_set.straddle_group != 0;
+            }
+        }
+        bool covered = true, grouped = true;
+        bool rebucketed = grid.grid_.scale != r1Grid.scale;
+        std::set<std::tuple<uint16_t, uint16_t, uint32_t>> seen;  // copies of a straddling GeoSet are re-bucketed once
+        for (int cell = 0; cell < numR1Cells && rebucketed; cell++) {
+            for (uint32_t i = 0; i < r1Cells[cell].num_geo_sets; i++) {
+                const titanfall::GeoSet &geo_set = r1GeoSets[r1Cells[cell].first_geo_set + i];
+                if (geo_set.straddle_group != 0 && !seen.insert({geo_set.straddle_group, geo_set.num_primitives, geo_set.primitive}).second) {
+                    continue;
+                }
+                MinMax box = minmax_from_bounds(r1GeoBounds[r1Cells[cell].first_geo_set + i]);
+                alignas(16) float mins[4], maxs[4];
+                _mm_store_ps(mins, box.min);
+                _mm_store_ps(maxs, box.max);
+                std::set<int> &found = cellsOf[{geo_set.num_primitives, geo_set.primitive}];
+                for (int y = 0; y < grid.grid_.num_cells[1]; y++) {
+                    for (int x = 0; x < grid.grid_.num_cells[0]; x++) {
+                        float cellMin[2] = {(x + grid.grid_.cell_offset[0]) * grid.grid_.scale, (y + grid.grid_.cell_offset[1]) * grid.grid_.scale};
+                        if (cellMin[0] <= maxs[0] && cellMin[0] + grid.grid_.scale >= mins[0]
+                         && cellMin[1] <= maxs[1] && cellMin[1] + grid.grid_.scale >= mins[1]) {
+                            covered = covered && found.count(y * grid.grid_.num_cells[0] + x);
+                        }
+                    }
+                }
+                grouped = grouped && (found.size() <= 1 || straddles[{geo_set.num_primitives, geo_set.primitive}]);
+            }
+        }
+        check(covered, name + ": r1 GeoSets are in every cell they overlap");
+        check(grouped, name + ": straddling r1 GeoSets have a straddle group");
+    }
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,59 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "hash.hpp"
+
+
+int main(int argc, char* argv[]) {
+    std::mt19937 rng(0);
+    std::vector<char> data(1 << 20);
+    for (char &c : data) { c = static_cast<char>(rng()); }
+
+    int failures = 0;
+    // every length through the short & stripe paths, at every alignment
+    std::set<uint64_t> seen;
+    for (size_t length = 0; length < 2100; length++) {
+        uint64_t expected = hash::hash64(&data[16], length);
+        for (size_t offset = 1; offset < 16; offset++) {
+            std::vector<char> copy(&data[16], &data[16] + length);
+            copy.insert(copy.begin(), offset, 0);
+            if (hash::hash64(&copy[offset], length) != expected) {
+                if (failures++ < 16) { printf("length %zu: hash depends on alignment\n", length); }
+                break;
+            }
+        }
+        if (!seen.insert(expected).second) {
+            if (failures++ < 16) { printf("length %zu: collides w/ a shorter prefix\n", length); }
+        }
+        // flipping any single bit must change the hash
+        if (length > 0 && length < 300) {
+            for (size_t bit = 0; bit < length * 8; bit += 7) {
+                data[16 + bit / 8] ^= static_cast<char>(1 << (bit % 8));
+                if (hash::hash64(&data[16], length) == expected) {
+                    if (failures++ < 16) { printf("length %zu: bit %zu flip not detected\n", length, bit); }
+                }
+                data[16 + bit / 8] ^= static_cast<char>(1 << (bit % 8));
+            }
+        }
+    }
+    // a repeated stripe must not cancel out
+    std::vector<char> zeros(4096, 0), repeats(4096, 0);
+    for (size_t i = 0; i < repeats.size(); i += 64) { repeats[i] = 1; }
+    if (hash::hash64(zeros.data(), zeros.size()) == hash::hash64(repeats.data(), repeats.size())) {
+        printf("repeated stripes cancel out\n");
+        failures++;
+    }
+
+    const int repeats_1MiB = 256;
+    auto start = std::chrono::steady_clock::now();
+    uint64_t sink = 0;
+    for (int i = 0; i < repeats_1MiB; i++) { sink ^= hash::hash64(data.data(), data.size(), i); }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("hash64: %.2f GiB/s (%016llx)\n", repeats_1MiB / seconds / 1024, static_cast<unsigned long long>(sink));
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
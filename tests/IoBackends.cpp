@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bsp.hpp"
+#include "convert.hpp"
+#include "lumps.hpp"
+#include "output_file.hpp"
+#include "synthetic.hpp"
+
+namespace fs = std::filesystem;
+
+
+std::string read_file(const fs::path &path) {
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+
+// zero-length lumps at nonzero offsets, as r1 headers have (e.g. an empty TRICOLL_HEADER)
+// -- each starts where another lump (or the file) ends, so a writer mustn't mix up their buffers
+fs::path write_empty_lumps_map(const fs::path &input, const fs::path &output) {
+    std::string bsp = read_file(input);
+    BspHeader header;
+    memcpy(&header, bsp.data(), sizeof(header));
+    std::vector<uint32_t> offsets;
+    for (LumpHeader &lump : header.lumps) {
+        if (lump.offset != 0) { offsets.push_back(lump.offset); }
+    }
+    offsets.push_back(static_cast<uint32_t>(bsp.size()));
+    size_t next = 0;
+    for (int i = 0; i < 128 && next < offsets.size(); i++) {
+        if (header.lumps[i].offset == 0 && lumps::DESCRIPTORS[i].kind == lumps::Kind::COPY) {
+            header.lumps[i] = {offsets[next++], 0, 0, 0};
+        }
+    }
+    memcpy(bsp.data(), &header, sizeof(header));
+    synthetic::write_file(output, {bsp.begin(), bsp.end()});
+    return output;
+}
+
+
+// end to end conversion time w/ each --io backend, on a synthetic map padded out to a realistic size
+int main(int argc, char* argv[]) {
+    size_t mib = 64;
+    int repeats = 5;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--mib") == 0 && i + 1 < argc) {
+            mib = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--repeats") == 0 && i + 1 < argc) {
+            repeats = std::max(1, atoi(argv[++i]));
+        } else {
+            printf("USAGE: %s [--mib size] [--repeats count]\n", argv[0]);
+            return 0;
+        }
+    }
+    fs::path work = fs::temp_directory_path() / "bsp_regen_io_backends";
+    fs::path input = synthetic::write_map(work, "map", 5, 2048, mib << 20);
+    std::string model_dir = (work / "r1").string();
+
+    int failures = 0;
+    // timed: prints the median of repeats conversions w/ each backend
+    auto compare = [&](const fs::path &map, int repeats, bool timed) {
+        std::string expected;
+        for (IoBackend backend : {IoBackend::MMAP, IoBackend::PWRITE, IoBackend::URING}) {
+            fs::path output = work / (std::string(io_backend_name(backend)) + ".bsp");
+            ConvertOptions options;
+            options.num_threads = std::max(1u, std::thread::hardware_concurrency());
+            options.print_report = false;
+            options.write_hashes = false;
+            options.io = backend;
+            options.model_dir = model_dir.c_str();
+            std::vector<double> times;
+            for (int i = 0; i < repeats; i++) {
+                auto start = std::chrono::steady_clock::now();
+                convert(map.string().c_str(), output.string().c_str(), options);
+                times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            }
+            std::sort(times.begin(), times.end());
+            if (timed) { printf("  --io=%-7s %8.2f ms\n", io_backend_name(backend), times[times.size() / 2] * 1000); }
+
+            std::string written = read_file(output);
+            if (expected.empty()) {
+                expected = written;
+            } else if (written != expected) {
+                printf("FAILED: %s: --io=%s output differs from --io=mmap\n", map.filename().string().c_str(), io_backend_name(backend));
+                failures++;
+            }
+        }
+    };
+    printf("%zu MiB map, median of %d conversions\n", static_cast<size_t>(fs::file_size(input) >> 20), repeats);
+    compare(input, repeats, true);
+    fs::path small = synthetic::write_map(work, "small", 6, 2048);
+    compare(write_empty_lumps_map(small, work / "empty_lumps.bsp"), 20, false);
+    fs::remove_all(work);
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
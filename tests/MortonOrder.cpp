@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "bounds.hpp"
+#include "cm_query.hpp"
+#include "convert.hpp"
+#include "synthetic.hpp"
+
+namespace fs = std::filesystem;
+
+
+// each worldspawn cell's prop GeoSets, as sorted lists of the props they hold; independent of emission order
+std::vector<std::vector<std::vector<uint32_t>>> propsPerCell(cm::Grid &grid) {
+    std::vector<std::vector<std::vector<uint32_t>>> cells(grid.numWorldCells());
+    for (int cell = 0; cell < grid.numWorldCells(); cell++) {
+        for (uint32_t i = 0; i < grid.cells_[cell].num_geo_sets; i++) {
+            titanfall::GeoSet &geo_set = grid.geo_sets_[grid.cells_[cell].first_geo_set + i];
+            std::vector<uint32_t> props;
+            if (geo_set.num_primitives == 1) {
+                if (cm::primitive_type(geo_set.primitive) == titanfall::PROP) { props.push_back(geo_set.primitive); }
+            } else {
+                uint32_t first = cm::primitive_index(geo_set.primitive);
+                for (uint32_t j = 0; j < geo_set.num_primitives; j++) {
+                    if (cm::primitive_type(grid.primitives_[first + j]) == titanfall::PROP) { props.push_back(grid.primitives_[first + j]); }
+                }
+            }
+            if (props.empty()) { continue; }
+            std::sort(props.begin(), props.end());
+            cells[cell].push_back(props);
+        }
+        std::sort(cells[cell].begin(), cells[cell].end());
+    }
+    return cells;
+}
+
+
+int main(int argc, char* argv[]) {
+    int failures = 0;
+    auto check = [&](bool ok, const std::string &message) {
+        if (!ok) { printf("FAILED: %s\n", message.c_str()); failures++; }
+    };
+
+    // Z-order: x in bit 0, y in bit 1, z in bit 2; the most negative origin sorts first
+    auto at = [](int16_t x, int16_t y, int16_t z) { return titanfall::Bounds{{x, y, z}, 0, {1, 1, 1}, -32767}; };
+    check(morton_code(at(-32768, -32768, -32768)) == 0, "morton_code of the minimum origin");
+    check(morton_code(at(-32767, -32768, -32768)) == 1 && morton_code(at(-32768, -32767, -32768)) == 2
+       && morton_code(at(-32768, -32768, -32767)) == 4, "morton_code interleaves x, y & z");
+    check(morton_code(at(32767, 32767, 32767)) == (1ull << 48) - 1, "morton_code of the maximum origin");
+    check(morton_code(at(-1, -1, -1)) < morton_code(at(0, 0, 0)) && morton_code(at(0, 0, 0)) < morton_code(at(1, 1, 1)),
+        "morton_code increases along the diagonal");
+
+    fs::path work = fs::temp_directory_path() / "bsp_regen_morton_order";
+    fs::remove_all(work);
+    fs::path input = synthetic::write_map(work, "map", 5, 2000);
+    std::string model_dir = (work / "r1").string();
+    std::string straddle_order = (work / "straddle.bsp").string(), morton_order = (work / "morton.bsp").string();
+    ConvertOptions options = {.print_report = false, .write_hashes = false, .model_dir = model_dir.c_str()};
+    check(convert(input.string().c_str(), straddle_order.c_str(), options) == 0, "converts");
+    options.morton_order = true;
+    check(convert(input.string().c_str(), morton_order.c_str(), options) == 0, "converts w/ morton_order");
+
+    Bsp straddle_bsp(straddle_order.c_str()), morton_bsp(morton_order.c_str());
+    cm::Grid straddle_grid(straddle_bsp), morton_grid(morton_bsp);
+    check(propsPerCell(straddle_grid) == propsPerCell(morton_grid), "every cell holds the same prop GeoSets");
+    check(straddle_grid.primitives_.size() == morton_grid.primitives_.size(), "same number of Primitives");
+    check(straddle_grid.grid_.num_straddle_groups == morton_grid.grid_.num_straddle_groups, "same number of straddle groups");
+
+    // multi-prop GeoSets are emitted in Morton order, w/ their children in Morton order too
+    std::map<uint32_t, titanfall::Bounds> multiProp;  // first primitive: GeoSet bounds
+    bool children_sorted = true;
+    for (int cell = 0; cell < morton_grid.numWorldCells(); cell++) {
+        for (uint32_t i = 0; i < morton_grid.cells_[cell].num_geo_sets; i++) {
+            uint32_t index = morton_grid.cells_[cell].first_geo_set + i;
+            titanfall::GeoSet &geo_set = morton_grid.geo_sets_[index];
+            uint32_t first = cm::primitive_index(geo_set.primitive);
+            if (geo_set.num_primitives == 1 || cm::primitive_type(morton_grid.primitives_[first]) != titanfall::PROP) { continue; }
+            multiProp[first] = morton_grid.geo_set_bounds_[index];
+            for (uint32_t j = 1; j < geo_set.num_primitives; j++) {
+                children_sorted = children_sorted && morton_code(morton_grid.primitive_bounds_[first + j - 1])
+                                                 <= morton_code(morton_grid.primitive_bounds_[first + j]);
+            }
+        }
+    }
+    check(multiProp.size() > 1, "the map has GeoSets w/ more than 1 prop");
+    check(children_sorted, "child Primitives are in Morton order");
+    uint64_t last = 0;
+    bool geo_sets_sorted = true;
+    for (auto &[first, bounds] : multiProp) {
+        geo_sets_sorted = geo_sets_sorted && morton_code(bounds) >= last;
+        last = morton_code(bounds);
+    }
+    check(geo_sets_sorted, "multi-prop GeoSets are in Morton order");
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
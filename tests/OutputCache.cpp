@@ -0,0 +1,104 @@
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "convert.hpp"
+#include "output_cache.hpp"
+#include "synthetic.hpp"
+
+namespace fs = std::filesystem;
+
+
+std::string read_file(const fs::path &path) {
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+
+int main(int argc, char* argv[]) {
+    fs::path work = fs::temp_directory_path() / "bsp_regen_output_cache";
+    fs::remove_all(work);
+    fs::path input = synthetic::write_map(work, "map", 3, 256);
+    fs::path cache_dir = work / "cache";
+    std::string model_dir = (work / "r1").string();
+
+    int failures = 0;
+    auto check = [&](bool ok, const char *message) {
+        if (!ok) { printf("FAILED: %s\n", message); failures++; }
+    };
+    auto entries = [&]() {
+        size_t count = 0;
+        for (auto &entry : fs::directory_iterator(cache_dir)) { count += entry.path().filename().string()[0] != '.'; }
+        return count;
+    };
+
+    ConvertOptions options;
+    options.print_report = false;
+    options.model_dir = model_dir.c_str();
+    std::string uncached = (work / "uncached.bsp").string();
+    convert(input.string().c_str(), uncached.c_str(), options);
+
+    std::string cache_dir_string = cache_dir.string();
+    options.cache_dir = cache_dir_string.c_str();
+    std::string miss = (work / "miss.bsp").string();
+    std::string hit  = (work / "hit.bsp").string();
+    check(convert(input.string().c_str(), miss.c_str(), options) == 0, "first conversion");
+    check(entries() == 1, "first conversion is inserted");
+    check(convert(input.string().c_str(), hit.c_str(), options) == 0, "second conversion");
+    check(entries() == 1, "second conversion is a hit");
+    check(read_file(hit) == read_file(uncached), "hit matches an uncached conversion");
+    std::string hashes = read_file(hit + ".hashes");
+    check(hashes.find(hit) != std::string::npos, "hit .hashes names the new output");
+    std::string original = read_file(miss + ".hashes");
+    check(hashes.substr(hashes.find('\n')) == original.substr(original.find('\n')), "hit .hashes matches");
+
+    // overwriting a hardlinked output must not reach the cache
+    ConvertOptions no_cache = {.print_report = false, .model_dir = model_dir.c_str()};
+    convert(input.string().c_str(), hit.c_str(), no_cache);
+    check(read_file(cache_dir / fs::directory_iterator(cache_dir)->path().filename() / "map.bsp") == read_file(uncached),
+        "cache entry survives overwriting the output");
+
+    // any model change is a miss
+    fs::path model = *fs::recursive_directory_iterator(work / "r1");
+    while (fs::is_directory(model)) { model = *fs::directory_iterator(model); }
+    fs::last_write_time(model, fs::last_write_time(model) + std::chrono::seconds(1));
+    convert(input.string().c_str(), miss.c_str(), options);
+    check(entries() == 2, "touching a model is a miss");
+
+    // the most recently used entry is kept
+    options.cache_size = fs::file_size(uncached) + 4096;
+    fs::path other = synthetic::write_map(work, "other", 4, 16);
+    convert(other.string().c_str(), miss.c_str(), options);
+    check(entries() == 1, "least recently used entries are evicted");
+    OutputCache cache(cache_dir, options.cache_size);
+    Bsp r1bsp(other.string().c_str());
+    GameLumpView<titanfall::StaticProp> gameLump(r1bsp);
+    check(fs::is_directory(cache.entry(OutputCache::key(r1bsp, gameLump,
+        [&](const ModelDictEntry &entry) { return modelPath(options, entry); }, outputSettings(options)))), "newest entry is kept");
+
+    // concurrent workers converting the same map all succeed, & leave 1 entry
+    options.cache_size = 4ull << 30;
+    fs::remove_all(cache_dir);
+    std::vector<std::thread> workers;
+    std::vector<int> results(8);
+    for (int i = 0; i < 8; i++) {
+        workers.emplace_back([&, i]() {
+            std::string output = (work / ("worker_" + std::to_string(i) + ".bsp")).string();
+            ConvertOptions worker_options = options;
+            results[i] = convert(input.string().c_str(), output.c_str(), worker_options);
+        });
+    }
+    for (auto &worker : workers) { worker.join(); }
+    for (int i = 0; i < 8; i++) {
+        check(results[i] == 0 && read_file(work / ("worker_" + std::to_string(i) + ".bsp")) == read_file(uncached), "concurrent worker output");
+    }
+    check(entries() == 1, "concurrent workers leave 1 entry");
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "convert.hpp"
+#include "models.hpp"
+#include "synthetic.hpp"
+
+namespace fs = std::filesystem;
+
+
+std::string read_file(const fs::path &path) {
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+
+bool same(const LocalBox &a, const LocalBox &b) {
+    return memcmp(&a, &b, sizeof(LocalBox)) == 0;
+}
+
+
+// per-tri AABB footprints: opt-in, padded, & malformed trees fall back to the root bbox
+// -- w/ --models dir, reports how the inferred node layout fares against every .mdl under dir (e.g. real r1 models)
+int main(int argc, char* argv[]) {
+    if (argc == 3 && strcmp(argv[1], "--models") == 0) {
+        uint32_t no_tree = 0, accepted = 0, rejected = 0, failed = 0;
+        for (auto &file : fs::recursive_directory_iterator(argv[2])) {
+            if (file.path().extension() != ".mdl") { continue; }
+            try {
+                Model model(file.path().string().c_str());
+                mstudiopertrihdr_t *perTri = model.getPerTriHeader();
+                if (perTri == nullptr) { no_tree++; continue; }
+                std::vector<LocalBox> boxes = model.getFootprint(16);
+                bool fallback = boxes.size() == 1 && same(boxes[0], {perTri->bbmin, perTri->bbmax});
+                if (fallback) {
+                    rejected++;
+                    printf("root bbox only: %s\n", file.path().string().c_str());
+                } else {
+                    accepted++;
+                }
+            } catch (std::exception &e) {
+                failed++;
+                printf("failed: %s (%s)\n", file.path().string().c_str(), e.what());
+            }
+        }
+        printf("%u trees accepted, %u fell back to the root bbox (no nodes, or malformed), %u w/o a per-tri header, %u unreadable\n", accepted, rejected, no_tree, failed);
+        return 0;
+    }
+
+    fs::path work = fs::temp_directory_path() / "bsp_regen_per_tri_tree";
+    fs::remove_all(work);
+    fs::path input = synthetic::write_map(work, "map", 10, 600);
+    std::string model_dir = (work / "r1").string();
+
+    int failures = 0;
+    auto check = [&](bool ok, const std::string &message) {
+        if (!ok) { printf("FAILED: %s\n", message.c_str()); failures++; }
+    };
+
+    // ell.mdl: 2 leaves, each covering an arm of the L
+    {
+        Model ell((work / "r1" / "models" / "ell.mdl").string().c_str());
+        LocalBox root = {ell.getPerTriHeader()->bbmin, ell.getPerTriHeader()->bbmax};
+        std::vector<LocalBox> off = ell.getFootprint(0);
+        check(off.size() == 1 && same(off[0], root), "depth 0 is just the root bbox");
+        std::vector<LocalBox> leaves = ell.getFootprint(3);
+        check(leaves.size() == 2, "depth 3 reaches both leaves");
+        float step = 1024.0f / 65535.0f;
+        for (const LocalBox &leaf : leaves) {
+            float far = std::min(leaf.maxs.x, leaf.maxs.y);  // the arm's narrow side, quantised at 8000
+            check(leaf.mins.x <= -step * 0.99f && leaf.mins.y <= -step * 0.99f, "leaves are padded below by a quantisation step");
+            check(far >= 1024.0f * 8000 / 65535 + step * 0.99f, "leaves are padded above by a quantisation step");
+        }
+    }
+
+    // a child outside its parent: the layout isn't what we think it is
+    {
+        std::vector<mstudiopertrinode_t> nodes = {
+            {{0, 0, 0}, {30000, 30000, 30000}, 1, 0},
+            {{0, 0, 0}, {65535, 8000, 65535}, 0, PERTRI_NODE_LEAF},
+            {{0, 0, 0}, {8000, 30000, 30000}, 0, PERTRI_NODE_LEAF}};
+        synthetic::ModelFile bad = synthetic::make_model("models/bad.mdl", {0, 0, 0}, {64, 64, 64}, 0x1, nodes);
+        synthetic::write_file(work / "bad" / bad.name, bad.data);
+        Model model((work / "bad" / bad.name).string().c_str());
+        std::vector<LocalBox> boxes = model.getFootprint(3);
+        check(boxes.size() == 1 && same(boxes[0], {{0, 0, 0}, {64, 64, 64}}), "a child outside its parent falls back to the root bbox");
+    }
+
+    // conversions only footprint when asked to
+    ConvertOptions options = {.print_report = false, .write_hashes = false, .model_dir = model_dir.c_str()};
+    std::string plain = (work / "plain.bsp").string(), footprinted = (work / "footprinted.bsp").string();
+    check(convert(input.string().c_str(), plain.c_str(), options) == 0, "converts w/o footprints");
+    options.footprint_depth = 3;
+    check(convert(input.string().c_str(), footprinted.c_str(), options) == 0, "converts w/ footprints");
+    check(read_file(plain) != read_file(footprinted), "footprints drop GridCells the ell never reaches");
+    check(outputSettings(options) != outputSettings({}), "footprint depth is part of the output cache key");
+
+    fs::remove_all(work);
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,78 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "static_props.hpp"
+
+
+int main(int argc, char* argv[]) {
+    // random bytes in every field, so a misplaced byte can't hide behind a 0
+    const size_t num_props = 4096;
+    std::mt19937 rng(0);
+    std::vector<char> in(num_props * sizeof(titanfall::StaticProp) + 1);
+    for (char &c : in) { c = static_cast<char>(rng()); }
+    // unaligned in & out, to match props inside the GAME_LUMP
+    const char *r1Props = &in[1];
+
+    std::vector<char> scalar(num_props * sizeof(titanfall2::StaticProp) + 1);
+    std::vector<char> bulk(num_props * sizeof(titanfall2::StaticProp) + 1);
+    convert_static_props_scalar(r1Props, &scalar[1], num_props);
+    convert_static_props(r1Props, &bulk[1], num_props);
+
+    int failures = 0;
+    for (size_t i = 0; i < num_props; i++) {
+        titanfall::StaticProp  r1;
+        titanfall2::StaticProp r2;
+        memcpy(&r1, &r1Props[i * sizeof(r1)], sizeof(r1));
+        memcpy(&r2, &bulk[1 + i * sizeof(r2)], sizeof(r2));
+
+        #define CHECK_FIELD(r1_field, r2_field) \
+            if (memcmp(&r1.r1_field, &r2.r2_field, sizeof(r2.r2_field)) != 0) { \
+                if (failures++ < 16) { printf("prop %zu: " #r2_field " mismatch\n", i); } }
+
+        CHECK_FIELD(origin,                 origin);
+        CHECK_FIELD(angles,                 angles);
+        CHECK_FIELD(scale,                  scale);
+        CHECK_FIELD(model_name,             model_name);
+        CHECK_FIELD(solid_type,             solid_type);
+        CHECK_FIELD(flags,                  flags);
+        CHECK_FIELD(skin,                   skin);
+        CHECK_FIELD(cubemap,                cubemap);
+        CHECK_FIELD(forced_fade_scale,      forced_fade_scale);
+        CHECK_FIELD(lighting_origin,        lighting_origin);
+        CHECK_FIELD(diffuse_modulation_r,   diffuse_modulation_r);
+        CHECK_FIELD(diffuse_modulation_g,   diffuse_modulation_g);
+        CHECK_FIELD(diffuse_modulation_b,   diffuse_modulation_b);
+        CHECK_FIELD(diffuse_modulation_a,   diffuse_modulation_a);
+        CHECK_FIELD(collision_flags_add,    collision_flags_add);
+        CHECK_FIELD(collision_flags_remove, collision_flags_remove);
+
+        #undef CHECK_FIELD
+
+        if (memcmp(&scalar[1 + i * sizeof(r2)], &r2, sizeof(r2)) != 0) {
+            if (failures++ < 16) { printf("prop %zu: bulk & scalar output differ\n", i); }
+        }
+    }
+    // nothing written outside of the output
+    if (bulk[0] != 0 || scalar[0] != 0) {
+        printf("wrote before output\n");
+        failures++;
+    }
+
+    // throughput on a large map's worth of props
+    const int repeats = 64;
+    auto time = [&](void (*convert)(const char*, char*, size_t)) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repeats; i++) { convert(r1Props, &bulk[1], num_props); }
+        auto end = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(end - start).count();
+        return (repeats * in.size()) / seconds / (1024 * 1024 * 1024);
+    };
+    printf("scalar: %.2f GiB/s read\n", time(convert_static_props_scalar));
+    printf("bulk:   %.2f GiB/s read\n", time(convert_static_props));
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
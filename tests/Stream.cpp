@@ -0,0 +1,118 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "convert.hpp"
+#include "synthetic.hpp"
+
+namespace fs = std::filesystem;
+
+
+std::string read_file(const fs::path &path) {
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+
+int main(int argc, char* argv[]) {
+    fs::path work = fs::temp_directory_path() / "bsp_regen_stream";
+    fs::remove_all(work);
+    fs::path input = synthetic::write_map(work, "map", 8, 1500, 4 << 20);
+    std::string model_dir = (work / "r1").string();
+
+    int failures = 0;
+    auto check = [&](bool ok, const std::string &message) {
+        if (!ok) { printf("FAILED: %s\n", message.c_str()); failures++; }
+    };
+
+    std::string reference = (work / "reference.bsp").string();
+    ConvertOptions options = {.print_report = false, .model_dir = model_dir.c_str()};
+    check(convert(input.string().c_str(), reference.c_str(), options) == 0, "converts to a file");
+    std::string expected = read_file(reference);
+
+    // a pipe can't seek or be mapped; read it on another thread, as an upload would
+    for (unsigned threads : {1u, 4u}) {
+        std::string name = "-j " + std::to_string(threads);
+        int fds[2];
+        check(pipe(fds) == 0, "pipe");
+        std::string streamed;
+        std::thread reader([&]() {
+            char chunk[65536];
+            ssize_t length;
+            while ((length = read(fds[0], chunk, sizeof(chunk))) > 0) {
+                streamed.append(chunk, static_cast<size_t>(length));
+            }
+            close(fds[0]);
+        });
+        std::string hashes_for = (work / ("streamed_" + std::to_string(threads) + ".bsp")).string();
+        ConvertOptions stream = options;
+        stream.num_threads = threads;
+        stream.output_fd = fds[1];
+        int ret = convert(input.string().c_str(), hashes_for.c_str(), stream);
+        close(fds[1]);
+        reader.join();
+        check(ret == 0, name + ": streams");
+        check(streamed == expected, name + ": streamed bytes match the file conversion");
+        check(!fs::exists(hashes_for), name + ": no output file is created");
+        std::string digest = read_file(hashes_for + ".hashes").substr(0, 22);  // "file " + 16 hex digits
+        check(digest == read_file(reference + ".hashes").substr(0, 22), name + ": same file digest");
+    }
+
+    // streaming to stdout: the report & allocation stats go to stderr, so stdout carries only the map
+    {
+        int fds[2];
+        check(pipe(fds) == 0, "pipe");
+        std::string streamed;
+        std::thread reader([&]() {
+            char chunk[65536];
+            ssize_t length;
+            while ((length = read(fds[0], chunk, sizeof(chunk))) > 0) {
+                streamed.append(chunk, static_cast<size_t>(length));
+            }
+            close(fds[0]);
+        });
+        fflush(stdout);
+        int saved_stdout = dup(fileno(stdout));
+        dup2(fds[1], fileno(stdout));
+        close(fds[1]);
+        ConvertOptions stream = options;
+        stream.print_report = true;
+        stream.write_hashes = false;
+        stream.alloc_stats = true;
+        stream.output_fd = fileno(stdout);
+        int ret = convert(input.string().c_str(), nullptr, stream);
+        fflush(stdout);
+        dup2(saved_stdout, fileno(stdout));
+        close(saved_stdout);
+        reader.join();
+        alloc_stats::enabled = false;
+        check(ret == 0, "streams to stdout");
+        check(streamed == expected, "stdout carries only the map, w/ the report & allocation stats on");
+    }
+
+    // options that need a seekable file are refused, before anything is written
+    for (int which = 0; which < 3; which++) {
+        ConvertOptions stream = options;
+        stream.output_fd = 1;
+        stream.verify = which == 0;
+        stream.external_threshold = which == 1 ? 1024 : 0;
+        std::string cache_dir = (work / "cache").string();
+        if (which == 2) { stream.cache_dir = cache_dir.c_str(); }
+        bool refused = false;
+        try {
+            convert(input.string().c_str(), nullptr, stream);
+        } catch (std::invalid_argument &) {
+            refused = true;
+        }
+        check(refused, "streaming refuses option " + std::to_string(which));
+    }
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
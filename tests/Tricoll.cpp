@@ -0,0 +1,75 @@
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "tricoll.hpp"
+
+
+void write10Bit(std::vector<uint32_t> &words, uint64_t offset, uint32_t data) {
+    uint64_t buffer = words[offset / 32] | (static_cast<uint64_t>(words[offset / 32 + 1]) << 32);
+    buffer &= ~(0x3FFull << (offset & 0x1F));
+    buffer |= static_cast<uint64_t>(data & 0x3FF) << (offset & 0x1F);
+    words[offset / 32]     = static_cast<uint32_t>(buffer);
+    words[offset / 32 + 1] = static_cast<uint32_t>(buffer >> 32);
+}
+
+
+// r1 (10-bit) & r2 (11-bit) encodings of the same bevels must decode to the same values
+int main(int argc, char* argv[]) {
+    std::mt19937 rng(0);
+    std::vector<uint32_t> values;
+    std::vector<uint32_t> tris;
+    std::vector<uint16_t> starts;
+    // 1 TricollHeader; every 4th triangle is an escape coded chain, which ends at once (it points at header 0)
+    while (values.size() < 0xF000) {
+        starts.push_back(static_cast<uint16_t>(values.size()));
+        uint32_t count = rng() % 8;
+        if (tris.size() % 4 == 3) {
+            tris.push_back(15u << 24);
+            uint32_t data = count + 1;  // {num_bevels, tricoll index 0}
+            values.push_back(data & 0x3FF);
+            values.push_back(data >> 10);
+            count++;
+        } else {
+            tris.push_back(count << 24);
+        }
+        for (uint32_t j = 0; j < count; j++) { values.push_back(rng() % 1024); }
+    }
+
+    // r1 has a word of read-ahead padding, r2 streams are packed to whole words
+    std::vector<uint32_t> r1((values.size() * 10 + 31) / 32 + 2, 0);
+    std::vector<uint32_t> r2((values.size() * 11 + 31) / 32 + 1, 0);
+    for (size_t i = 0; i < values.size(); i++) {
+        write10Bit(r1, i * 10, values[i]);
+        write11Bit(r2.data(), i * 11, values[i]);
+    }
+    r2.pop_back();
+
+    titanfall::TricollHeader header = {};
+    header.num_triangles = static_cast<uint16_t>(tris.size());
+    header.num_bevel_indices = static_cast<uint16_t>(values.size());
+    std::vector<titanfall::TricollHeader> headers = {header};
+
+    int failures = 0;
+    tricoll::VerifyReport report = tricoll::verify(headers, r1, headers, r2, tris, starts);
+    report.print();
+    if (report.num_errors != 0 || report.num_triangles != tris.size()) { failures++; }
+
+    // a flipped bit in r2 must be caught
+    r2[r2.size() / 2] ^= 1u << 7;
+    report = tricoll::verify(headers, r1, headers, r2, tris, starts);
+    report.print();
+    if (report.num_errors == 0) { failures++; }
+
+    // as must a chain pointing at a TricollHeader that doesn't exist
+    uint32_t data = 1 | (5 << 7);
+    write10Bit(r1, starts[3] * 10ull, data & 0x3FF);
+    write10Bit(r1, starts[3] * 10ull + 10, data >> 10);
+    std::vector<uint32_t> decoded;
+    std::string error = tricoll::decode_bevels<10>(r1, header.num_bevel_indices, starts[3], 15, 0, 1, decoded);
+    printf("chain to header 5: %s\n", error.c_str());
+    if (error.empty()) { failures++; }
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,84 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <thread>
+
+#include "convert.hpp"
+#include "synthetic.hpp"
+#include "watch.hpp"
+
+namespace fs = std::filesystem;
+
+
+std::string read_file(const fs::path &path) {
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+
+// true once ready() is, false after 5s
+bool wait_for(const std::function<bool()> &ready) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!ready()) {
+        if (std::chrono::steady_clock::now() > deadline) { return false; }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
+
+int main(int argc, char* argv[]) {
+    fs::path work = fs::temp_directory_path() / "bsp_regen_watch";
+    fs::remove_all(work);
+    fs::path source = synthetic::write_map(work, "source", 6, 64);
+    fs::create_directories(work / "in");
+    std::string model_dir = (work / "r1").string();
+
+    int failures = 0;
+    auto check = [&](bool ok, const char *message) {
+        if (!ok) { printf("FAILED: %s\n", message); failures++; }
+    };
+
+    ConvertOptions options = {.print_report = false, .write_hashes = false, .model_dir = model_dir.c_str()};
+    std::string expected_path = (work / "expected.bsp").string();
+    convert(source.string().c_str(), expected_path.c_str(), options);
+    std::string expected = read_file(expected_path);
+
+    // already converted & up to date, so not converted again at startup
+    fs::copy_file(source, work / "in" / "old.bsp");
+    fs::create_directories(work / "out");
+    fs::copy_file(expected_path, work / "out" / "old.bsp");
+
+    Watcher watcher(work / "in", work / "out", options);
+    std::atomic<bool> stop = false;
+    std::thread watching([&]() { watcher.run(stop); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    check(watcher.conversions_ == 0, "up to date maps aren't converted at startup");
+
+    // a burst of writes is 1 conversion
+    fs::copy_file(source, work / "in" / "new.bsp");
+    for (int i = 0; i < 3; i++) { fs::last_write_time(work / "in" / "new.bsp", fs::file_time_type::clock::now()); }
+    std::ofstream(work / "in" / "new.bsp", std::ios::binary | std::ios::app).flush();
+    check(wait_for([&]() { return read_file(work / "out" / "new.bsp") == expected; }), "new map is converted");
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    check(watcher.conversions_ == 1, "a burst of writes is debounced");
+
+    // both maps use every synthetic model
+    fs::path model = *fs::recursive_directory_iterator(work / "r1");
+    while (fs::is_directory(model)) { model = *fs::directory_iterator(model); }
+    std::string contents = read_file(model);
+    synthetic::write_file(model, std::vector<char>(contents.begin(), contents.end()));
+    check(wait_for([&]() { return watcher.conversions_ == 3; }), "changing a model reconverts the maps using it");
+    check(read_file(work / "out" / "old.bsp") == expected, "reconverted output");
+    check(watcher.models_.hits_ > 0, "model metadata is reused");
+
+    stop = true;
+    watching.join();
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
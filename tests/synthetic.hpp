@@ -0,0 +1,264 @@
+// deterministic synthetic Titanfall maps & models, for tests w/o copyrighted game files
+// NOTE: lump contents are plausible, not playable; just enough to exercise every conversion stage
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bsp.hpp"
+#include "models.hpp"
+#include "source.hpp"
+#include "titanfall.hpp"
+
+
+namespace synthetic {
+    // splitmix64; unlike <random> distributions, identical on every platform
+    struct Rng {
+        uint64_t state;
+
+        uint64_t next() {
+            uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        int range(int min, int max) {  // inclusive
+            return min + static_cast<int>(next() % static_cast<uint64_t>(max - min + 1));
+        }
+
+        float uniform(float min, float max) {
+            return min + (max - min) * static_cast<float>(next() >> 40) / static_cast<float>(1 << 24);
+        }
+    };
+
+
+    template <typename T>
+    void append(std::vector<char> &buffer, const T &value) {
+        const char *bytes = reinterpret_cast<const char*>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+
+
+    struct ModelFile {
+        std::string        name;  // relative to the model dir
+        std::vector<char>  data;
+    };
+
+
+    ModelFile make_model(const char *name, Vector3 mins, Vector3 maxs, uint32_t contents, std::vector<mstudiopertrinode_t> nodes = {}) {
+        studiohdr_t header = {};
+        header.contents = contents;
+        header.studiohdr2_index = sizeof(studiohdr_t);
+        studiohdr2_t header2 = {};
+        header2.per_tri_AABB_index = sizeof(studiohdr2_t);
+        header2.per_tri_AABB_node_count = static_cast<int32_t>(nodes.size());
+        mstudiopertrihdr_t perTri = {.version = 2, .unk = 0, .bbmin = mins, .bbmax = maxs, .unused = {}};
+        ModelFile model = {name, {}};
+        append(model.data, header);
+        append(model.data, header2);
+        append(model.data, perTri);
+        for (auto &node : nodes) { append(model.data, node); }
+        return model;
+    }
+
+
+    // the same few models are shared by every synthetic map
+    std::vector<ModelFile> models() {
+        // L-shaped: 2 leaves covering the arms, leaving the far corner empty
+        std::vector<mstudiopertrinode_t> ell = {
+            {{0, 0, 0}, {65535, 65535, 65535}, 1, 0},
+            {{0, 0, 0}, {65535,  8000, 65535}, 0, PERTRI_NODE_LEAF},
+            {{0, 0, 0}, { 8000, 65535, 65535}, 0, PERTRI_NODE_LEAF}};
+        return {
+            make_model("models/crate.mdl", {-16, -16, 0}, {16, 16, 32}, 0x1),
+            make_model("models/fence.mdl", {-128, -4, 0}, {128, 4, 64}, 0x0),
+            make_model("models/ell.mdl", {0, 0, 0}, {1024, 1024, 64}, 0x1, ell)};
+    }
+
+
+    // tricoll bevels, r1 packs 10 bits per index
+    struct BitWriter {
+        std::vector<uint32_t> words;
+        uint64_t              bit = 0;
+
+        void write10(uint32_t value) {
+            if ((bit + 10) / 32 + 1 >= words.size()) { words.resize((bit + 10) / 32 + 2, 0); }
+            uint64_t buffer = words[bit / 32] | (static_cast<uint64_t>(words[bit / 32 + 1]) << 32);
+            buffer |= static_cast<uint64_t>(value & 0x3FF) << (bit & 0x1F);
+            words[bit / 32]     = static_cast<uint32_t>(buffer);
+            words[bit / 32 + 1] = static_cast<uint32_t>(buffer >> 32);
+            bit += 10;
+        }
+    };
+
+
+    titanfall::Bounds aabb(Rng &rng, int16_t extent) {
+        return {
+            .origin  = {static_cast<int16_t>(rng.range(-1000, 1000)), static_cast<int16_t>(rng.range(-1000, 1000)), 0},
+            .sin     = 0,
+            .extents = {extent, extent, extent},
+            .cos     = -32768};
+    }
+
+
+    // r1 .bsp bytes; props reference models()
+    // -- raw_size pads out a lump that is copied as is, to stand in for a big map's textures & lighting
+    std::vector<char> make_map(uint64_t seed, uint32_t num_props, size_t raw_size = 1000) {
+        Rng rng = {seed};
+        std::vector<std::vector<char>> lumps(128);
+
+        // CM grid: 8x8 worldspawn cells + 2 bsp models
+        const int num_cells = 8, num_bsp_models = 2, num_straddle_groups = 3;
+        titanfall::Grid grid = {256.0f, {-4, -4}, {num_cells, num_cells}, num_straddle_groups, 0};
+        append(lumps[titanfall::CM_GRID], grid);
+        for (int i = 0; i < num_bsp_models; i++) { append(lumps[titanfall::MODELS], titanfall::Model{}); }
+        uint16_t num_geo_sets = 0, num_primitives = 0;
+        for (int cell = 0; cell < num_cells * num_cells + num_bsp_models; cell++) {
+            uint16_t count = static_cast<uint16_t>(rng.range(0, 3));
+            append(lumps[titanfall::CM_GRID_CELLS], titanfall::GridCell{num_geo_sets, count});
+            for (int i = 0; i < count; i++, num_geo_sets++) {
+                titanfall::GeoSet geo_set;
+                if (rng.range(0, 1)) {  // single tricoll
+                    geo_set = {static_cast<uint16_t>(rng.range(0, num_straddle_groups)), 1,
+                        (0x40u << 24) | (static_cast<uint32_t>(rng.range(0, 3)) << 8)};
+                } else {  // multiple brushes
+                    uint16_t children = static_cast<uint16_t>(rng.range(2, 4));
+                    geo_set = {0, children, static_cast<uint32_t>(num_primitives) << 8};
+                    for (int j = 0; j < children; j++, num_primitives++) {
+                        append(lumps[titanfall::CM_PRIMITIVES], static_cast<uint32_t>(rng.range(0, 9)) << 8);
+                        append(lumps[titanfall::CM_PRIMITIVE_BOUNDS], aabb(rng, 32));
+                    }
+                }
+                append(lumps[titanfall::CM_GEO_SETS], geo_set);
+                append(lumps[titanfall::CM_GEO_SET_BOUNDS], aabb(rng, 64));
+            }
+        }
+        append(lumps[titanfall::CM_UNIQUE_CONTENTS], 0xEB0281u);
+        append(lumps[titanfall::CM_UNIQUE_CONTENTS], 0x000001u);
+
+        // tricoll: every header has plain bevel lists, some have escape coded chains
+        const int num_tricoll = 4;
+        uint32_t num_tris = 0, num_words = 0;
+        for (int h = 0; h < num_tricoll; h++) {
+            uint16_t tris = static_cast<uint16_t>(rng.range(1, 6));
+            BitWriter bits;
+            for (int k = 0; k < tris; k++) {
+                uint16_t start = static_cast<uint16_t>(bits.bit / 10);
+                uint32_t num_bevels = static_cast<uint32_t>(rng.range(0, 4));
+                if (rng.range(0, 3) == 0) {  // escape coded chain: {count, tricoll index} then count indices
+                    num_bevels = 15;
+                    int links = rng.range(1, 2);
+                    for (int link = 0; link < links; link++) {
+                        uint32_t count = static_cast<uint32_t>(rng.range(1, 3));
+                        uint32_t index = link == links - 1 ? h : rng.range(0, num_tricoll - 1);
+                        uint32_t data = count | (index << 7);
+                        bits.write10(data & 0x3FF);
+                        bits.write10(data >> 10);
+                        for (uint32_t j = 0; j < count; j++) { bits.write10(rng.range(0, 1023)); }
+                        if (index == static_cast<uint32_t>(h)) { break; }
+                    }
+                } else {
+                    for (uint32_t j = 0; j < num_bevels; j++) { bits.write10(rng.range(0, 1023)); }
+                }
+                append(lumps[titanfall::TRICOLL_TRIS], num_bevels << 24);
+                append(lumps[titanfall::TRICOLL_BEVEL_STARTS], start);
+            }
+            bits.words.resize(bits.bit / 32 + 3, 0);  // BitReader reads ahead
+            titanfall::TricollHeader header = {};
+            header.num_triangles     = tris;
+            header.num_bevel_indices = static_cast<uint16_t>(bits.bit / 10);
+            header.first_triangle    = num_tris;
+            header.first_bevel_index = num_words;
+            header.scale             = 1.0f;
+            append(lumps[titanfall::TRICOLL_HEADER], header);
+            for (uint32_t word : bits.words) { append(lumps[titanfall::TRICOLL_BEVEL_INDICES], word); }
+            num_tris  += tris;
+            num_words += static_cast<uint32_t>(bits.words.size());
+        }
+
+        for (uint32_t i = 0; i < 10; i++) {
+            append(lumps[titanfall::LIGHTPROBE_REFS], titanfall::LightProbeRef{{rng.uniform(-1, 1), rng.uniform(-1, 1), rng.uniform(-1, 1)}, i});
+        }
+        lumps[titanfall::REAL_TIME_LIGHTS].resize(4 * 64, 0);
+        for (size_t i = 0; i < raw_size; i++) { lumps[0x02].push_back(static_cast<char>(rng.range(0, 255))); }  // raw copy
+
+        // GAME_LUMP: 1 sprp sub-lump, offset patched once the lump is placed
+        std::vector<char> sprp;
+        std::vector<ModelFile> model_files = models();
+        append(sprp, static_cast<uint32_t>(model_files.size()));
+        for (auto &model : model_files) {
+            char name[128] = {};
+            strncpy(name, model.name.c_str(), 127);
+            append(sprp, name);
+        }
+        append(sprp, 0u);  // num_leaves
+        append(sprp, num_props);
+        append(sprp, 0u);  // unknown_1
+        append(sprp, 0u);  // unknown_2
+        const float yaws[] = {0, 90, 45, -1};
+        for (uint32_t i = 0; i < num_props; i++) {
+            titanfall::StaticProp prop = {};
+            prop.origin     = {rng.uniform(-1000, 1000), rng.uniform(-1000, 1000), rng.uniform(-50, 50)};
+            float yaw       = yaws[rng.range(0, 3)];
+            prop.angles     = {rng.range(0, 3) == 0 ? 10.0f : 0.0f, yaw < 0 ? rng.uniform(0, 360) : yaw, 0};
+            prop.model_name = static_cast<uint16_t>(rng.range(0, static_cast<int>(model_files.size()) - 1));
+            prop.solid_type = rng.range(0, 2) ? 6 : 0;
+            prop.forced_fade_scale = 1.0f;
+            prop.diffuse_modulation_r = prop.diffuse_modulation_g = prop.diffuse_modulation_b = prop.diffuse_modulation_a = 255;
+            prop.scale      = rng.range(0, 1) ? 1.0f : 1.5f;
+            append(sprp, prop);
+        }
+        std::vector<char> &game_lump = lumps[titanfall::GAME_LUMP];
+        append(game_lump, 1u);
+        append(game_lump, source::GameLumpHeader{MAGIC_sprp, 0, titanfall::sprp_VERSION, 0, static_cast<uint32_t>(sprp.size())});
+        game_lump.insert(game_lump.end(), sprp.begin(), sprp.end());
+
+        // lumps are placed in a shuffled order, like the r1 compiler's order differs from index order
+        std::vector<int> order;
+        for (int i = 0; i < 128; i++) {
+            if (!lumps[i].empty()) { order.push_back(i); }
+        }
+        for (size_t i = order.size() - 1; i > 0; i--) {
+            std::swap(order[i], order[rng.next() % (i + 1)]);
+        }
+        BspHeader header = {.magic = MAGIC_rBSP, .version = titanfall::VERSION, .revision = 0, ._127 = 127, .lumps = {}};
+        std::vector<char> bsp(sizeof(header), 0);
+        for (int i : order) {
+            bsp.resize((bsp.size() + 3) & ~3, 0);
+            header.lumps[i] = {static_cast<uint32_t>(bsp.size()), static_cast<uint32_t>(lumps[i].size()), 0, 0};
+            if (i == titanfall::GAME_LUMP) {  // NOTE: sub-lump offsets are from the start of the file
+                uint32_t sprp_offset = static_cast<uint32_t>(bsp.size() + 4 + sizeof(source::GameLumpHeader));
+                memcpy(&lumps[i][4 + offsetof(source::GameLumpHeader, offset)], &sprp_offset, 4);
+            }
+            bsp.insert(bsp.end(), lumps[i].begin(), lumps[i].end());
+        }
+        memcpy(bsp.data(), &header, sizeof(header));
+        return bsp;
+    }
+
+
+    void write_file(const std::filesystem::path &path, const std::vector<char> &data) {
+        std::filesystem::create_directories(path.parent_path());
+        FILE *file = fopen(path.string().c_str(), "wb");
+        if (file == nullptr) { throw std::runtime_error("Failed to write " + path.string()); }
+        fwrite(data.data(), 1, data.size(), file);
+        fclose(file);
+    }
+
+
+    // writes <dir>/<name>.bsp & every model to <dir>/r1/
+    std::filesystem::path write_map(const std::filesystem::path &dir, const std::string &name, uint64_t seed, uint32_t num_props, size_t raw_size = 1000) {
+        for (auto &model : models()) {
+            write_file(dir / "r1" / model.name, model.data);
+        }
+        std::filesystem::path bsp_path = dir / (name + ".bsp");
+        write_file(bsp_path, make_map(seed, num_props, raw_size));
+        return bsp_path;
+    }
+};